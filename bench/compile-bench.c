@@ -0,0 +1,334 @@
+//
+// Compiler throughput benchmark
+//  Generates programs of growing size with program-generator, compiles each one with
+//  cbasic --time-report=json and prints the CPU time of every phase, the heap memory
+//  allocated and the peak resident set size per size. For every pair of consecutive
+//  sizes it then prints how each figure scaled, as the exponent of the growth (1.0 is
+//  linear), and flags figures that grew super-linearly. Exits with 1 if any did, or if
+//  a size failed to compile.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+#define SIZES_MAX			16
+#define PHASES_MAX			64
+#define NAME_MAX_LENGTH		48
+#define NAME_COLUMN			40
+
+//
+// Growth exponent above which a figure is flagged, and the smallest figure taken
+// into account, so that timer noise on tiny programs is not flagged
+//
+#define SCALING_LIMIT		1.3
+#define NOISE_FLOOR_MS		10.0
+#define NOISE_FLOOR_KB		1024.0
+
+//
+// A phase of the time report
+//
+struct phase
+{
+	char name[NAME_MAX_LENGTH];
+	int depth;
+	double cpu_ms[SIZES_MAX];
+};
+
+static struct phase phases[PHASES_MAX];
+static int phase_count = 0;
+
+static unsigned int sizes[SIZES_MAX];
+static int size_count = 0;
+
+// Memory of the whole compilation, per size
+static double allocated_kb[SIZES_MAX];
+static double peak_rss_kb[SIZES_MAX];
+
+static double now ()
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//
+// Run a program with its output sent to a file; returns its exit code, or -1 if it
+// could not run or was killed
+//
+static int run (char **argv, const char *output)
+{
+	posix_spawn_file_actions_t actions;
+	pid_t pid;
+	int status, rc;
+
+	posix_spawn_file_actions_init (&actions);
+	posix_spawn_file_actions_addopen (&actions, 1, output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	posix_spawn_file_actions_adddup2 (&actions, 1, 2);
+	rc = posix_spawn (&pid, argv[0], &actions, NULL, argv, environ);
+	posix_spawn_file_actions_destroy (&actions);
+	if (rc != 0)
+	{
+		return -1;
+	}
+	if (waitpid (pid, &status, 0) < 0)
+	{
+		return -1;
+	}
+	if (!WIFEXITED (status))
+	{
+		fprintf (stderr, "%s was killed by signal %d\n", argv[0], WTERMSIG (status));
+		return -1;
+	}
+
+	return WEXITSTATUS (status);
+}
+
+//
+// Get a number following a JSON key on a line
+//
+static double get_number (const char *line, const char *key)
+{
+	const char *found = strstr (line, key);
+	return (found != NULL ? atof (found + strlen (key)) : 0.0);
+}
+
+//
+// Read the time report of a size; every phase of the report is on a line of its own,
+// indented by its nesting
+//
+static int read_report (const char *file, int size)
+{
+	char line[1024];
+	FILE *report = fopen (file, "r");
+	if (report == NULL)
+	{
+		return -1;
+	}
+
+	while (fgets (line, sizeof (line), report) != NULL)
+	{
+		char *name = strstr (line, "\"name\": \"");
+		char *end;
+		int i;
+
+		if (name == NULL)
+		{
+			continue;
+		}
+		name += strlen ("\"name\": \"");
+		end = strchr (name, '"');
+		if (end == NULL || end - name >= NAME_MAX_LENGTH)
+		{
+			continue;
+		}
+		*end = '\0';
+
+		for (i = 0; i < phase_count && strcmp (phases[i].name, name) != 0; i ++);
+		if (i == phase_count)
+		{
+			if (phase_count == PHASES_MAX)
+			{
+				continue;
+			}
+			strcpy (phases[i].name, name);
+			phases[i].depth = (strspn (line, " ") - 4) / 2;
+			phase_count ++;
+		}
+		phases[i].cpu_ms[size] = get_number (end + 1, "\"cpu_ms\": ");
+
+		// The first phase spans the whole compilation
+		if (i == 0)
+		{
+			allocated_kb[size] = get_number (end + 1, "\"allocated_bytes\": ") / 1024;
+			peak_rss_kb[size] = get_number (end + 1, "\"peak_rss_kb\": ");
+		}
+	}
+
+	fclose (report);
+	return 0;
+}
+
+//
+// Print the growth exponents of a figure; returns 1 if it grew super-linearly
+//
+static int print_scaling (const char *name, int depth, const double *values, int count, double floor)
+{
+	int flagged = 0, i;
+
+	printf ("%*s%-*s", depth * 2, "", NAME_COLUMN - depth * 2, name);
+	for (i = 1; i < count; i ++)
+	{
+		if (values[i - 1] <= 0 || values[i] < floor)
+		{
+			printf ("%14s", "-");
+			continue;
+		}
+		double exponent = log (values[i] / values[i - 1]) / log ((double) sizes[i] / sizes[i - 1]);
+		printf ("%12.2f%s", exponent, exponent > SCALING_LIMIT ? " !" : "  ");
+		flagged |= (exponent > SCALING_LIMIT);
+	}
+	printf ("\n");
+
+	return flagged;
+}
+
+static void usage (const char *name)
+{
+	fprintf (stderr, "usage: %s [-t SECONDS] CBASIC GENERATOR [LINES...] [-- GENERATOR OPTIONS...]\n", name);
+	fprintf (stderr, "  -t SECONDS  skip the larger sizes once a compilation takes longer (default 600)\n");
+	fprintf (stderr, "  LINES       program sizes (default 1000 10000 100000 1000000)\n");
+}
+
+int main (int argc, char **argv)
+{
+	static const unsigned int default_sizes[] = { 1000, 10000, 100000, 1000000 };
+	char *generator_args[64];
+	int generator_argc = 0;
+	double time_limit = 600;
+	int compiled = 0, failed = 0, flagged = 0;
+	int i, c;
+
+	while ((c = getopt (argc, argv, "+t:")) != -1)
+	{
+		if (c != 't')
+		{
+			usage (argv[0]);
+			return 2;
+		}
+		time_limit = atof (optarg);
+	}
+	if (argc - optind < 2)
+	{
+		usage (argv[0]);
+		return 2;
+	}
+	const char *cbasic = argv[optind];
+	const char *generator = argv[optind + 1];
+
+	// Sizes and generator options
+	for (i = optind + 2; i < argc && strcmp (argv[i], "--") != 0; i ++)
+	{
+		if (size_count < SIZES_MAX)
+		{
+			sizes[size_count ++] = strtoul (argv[i], NULL, 10);
+		}
+	}
+	if (size_count == 0)
+	{
+		memcpy (sizes, default_sizes, sizeof (default_sizes));
+		size_count = sizeof (default_sizes) / sizeof (default_sizes[0]);
+	}
+	generator_args[generator_argc ++] = (char *) generator;
+	generator_args[generator_argc ++] = "-n";
+	generator_args[generator_argc ++] = NULL;
+	for (i ++; i < argc && generator_argc < 62; i ++)
+	{
+		generator_args[generator_argc ++] = argv[i];
+	}
+	generator_args[generator_argc] = NULL;
+
+	for (compiled = 0; compiled < size_count; compiled ++)
+	{
+		char lines[16], source[64], executable[64], log[64], report[80];
+		double start, elapsed;
+
+		snprintf (lines, sizeof (lines), "%u", sizes[compiled]);
+		snprintf (source, sizeof (source), "bench-%u.bas", sizes[compiled]);
+		snprintf (executable, sizeof (executable), "bench-%u", sizes[compiled]);
+		snprintf (log, sizeof (log), "bench-%u.log", sizes[compiled]);
+		snprintf (report, sizeof (report), "bench-%u.time.json", sizes[compiled]);
+
+		generator_args[2] = lines;
+		if (run (generator_args, source) != 0)
+		{
+			fprintf (stderr, "%s: failed to generate %u lines\n", generator, sizes[compiled]);
+			return 2;
+		}
+
+		char *cbasic_args[] = { (char *) cbasic, "-m", "--time-report=json", "-o", executable, source, NULL };
+		start = now ();
+		int rc = run (cbasic_args, log);
+		elapsed = now () - start;
+		if (rc != 0 || read_report (report, compiled) != 0)
+		{
+			fprintf (stderr, "%s: failed to compile %s, see %s\n", cbasic, source, log);
+			failed = 1;
+			break;
+		}
+		fprintf (stderr, "%9u lines compiled in %.2f s\n", sizes[compiled], elapsed);
+
+		unlink (executable);
+		if (elapsed > time_limit && compiled + 1 < size_count)
+		{
+			fprintf (stderr, "skipping larger sizes, compilation took longer than %.0f s\n", time_limit);
+			compiled ++;
+			break;
+		}
+	}
+	if (compiled == 0)
+	{
+		return 2;
+	}
+
+	// CPU time and memory per size
+	printf ("\n%-*s", NAME_COLUMN, "CPU ms / lines");
+	for (i = 0; i < compiled; i ++)
+	{
+		printf ("%14u", sizes[i]);
+	}
+	printf ("\n");
+	for (c = 0; c < phase_count; c ++)
+	{
+		printf ("%*s%-*s", phases[c].depth * 2, "", NAME_COLUMN - phases[c].depth * 2, phases[c].name);
+		for (i = 0; i < compiled; i ++)
+		{
+			printf ("%14.1f", phases[c].cpu_ms[i]);
+		}
+		printf ("\n");
+	}
+	printf ("%-*s", NAME_COLUMN, "allocated KB");
+	for (i = 0; i < compiled; i ++)
+	{
+		printf ("%14.0f", allocated_kb[i]);
+	}
+	printf ("\n%-*s", NAME_COLUMN, "peak RSS KB");
+	for (i = 0; i < compiled; i ++)
+	{
+		printf ("%14.0f", peak_rss_kb[i]);
+	}
+	printf ("\n");
+
+	// Growth between consecutive sizes
+	if (compiled > 1)
+	{
+		printf ("\n%-*s", NAME_COLUMN, "scaling exponent");
+		for (i = 1; i < compiled; i ++)
+		{
+			char range[32];
+			snprintf (range, sizeof (range), "%u->%u", sizes[i - 1], sizes[i]);
+			printf ("%14s", range);
+		}
+		printf ("\n");
+		for (c = 0; c < phase_count; c ++)
+		{
+			flagged |= print_scaling (phases[c].name, phases[c].depth, phases[c].cpu_ms, compiled, NOISE_FLOOR_MS);
+		}
+		flagged |= print_scaling ("allocated KB", 0, allocated_kb, compiled, NOISE_FLOOR_KB);
+		flagged |= print_scaling ("peak RSS KB", 0, peak_rss_kb, compiled, NOISE_FLOOR_KB);
+
+		if (flagged)
+		{
+			printf ("\n! super-linear scaling (exponent above %.1f)\n", SCALING_LIMIT);
+		}
+	}
+
+	return (flagged || failed);
+}
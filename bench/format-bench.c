@@ -0,0 +1,101 @@
+//
+// Microbenchmark for the runtime library number formatting routines
+//  Compares _fmt_int and _fmt_float against sprintf and checks that every
+//  float printed by _fmt_float reads back as the same float.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//
+// Runtime library (libcbasic.asm)
+//
+extern int _fmt_int (int value, char *buffer);
+extern int _fmt_float (float value, char *buffer);
+
+#define ITERATIONS		2000000
+
+static double now ()
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report (const char *name, double seconds, unsigned int checksum)
+{
+	printf ("%-24s %8.2f ns/call  (checksum %u)\n", name, seconds * 1e9 / ITERATIONS, checksum);
+}
+
+int main ()
+{
+	static int ints[ITERATIONS];
+	static float floats[ITERATIONS];
+	char buffer[64];
+	unsigned int checksum, seed = 12345;
+	unsigned int mismatches = 0;
+	double start;
+	int i;
+
+	// Mixed magnitude inputs
+	for (i = 0; i < ITERATIONS; i ++)
+	{
+		seed = seed * 1103515245 + 12345;
+		ints[i] = (int) seed >> (seed % 31);
+		seed = seed * 1103515245 + 12345;
+		memcpy (&floats[i], &seed, sizeof (float));
+		if ((seed & 0x7F800000) == 0x7F800000)
+		{
+			floats[i] = (float) ints[i] / 7.0f;
+		}
+	}
+
+	// Integers
+	start = now ();
+	for (i = 0, checksum = 0; i < ITERATIONS; i ++)
+	{
+		checksum += _fmt_int (ints[i], buffer);
+	}
+	report ("_fmt_int", now () - start, checksum);
+
+	start = now ();
+	for (i = 0, checksum = 0; i < ITERATIONS; i ++)
+	{
+		checksum += sprintf (buffer, "%d", ints[i]);
+	}
+	report ("sprintf (\"%d\")", now () - start, checksum);
+
+	// Floats
+	start = now ();
+	for (i = 0, checksum = 0; i < ITERATIONS; i ++)
+	{
+		checksum += _fmt_float (floats[i], buffer);
+	}
+	report ("_fmt_float", now () - start, checksum);
+
+	start = now ();
+	for (i = 0, checksum = 0; i < ITERATIONS; i ++)
+	{
+		checksum += sprintf (buffer, "%.9g", floats[i]);
+	}
+	report ("sprintf (\"%.9g\")", now () - start, checksum);
+
+	// Round trip check
+	for (i = 0; i < ITERATIONS; i ++)
+	{
+		float back;
+		buffer[_fmt_float (floats[i], buffer)] = 0;
+		back = strtof (buffer, NULL);
+		if (memcmp (&back, &floats[i], sizeof (float)) != 0)
+		{
+			if (mismatches ++ < 10)
+			{
+				printf ("round trip mismatch: %.9g printed as %s\n", floats[i], buffer);
+			}
+		}
+	}
+	printf ("round trip mismatches: %u\n", mismatches);
+
+	return (mismatches == 0 ? 0 : 1);
+}
@@ -0,0 +1,232 @@
+//
+// Semantic analysis benchmark
+//  Generates programs of growing size with program-generator and checks each one with
+//  cbasic --check twice: with the semantic analysis passes fused into as few tree
+//  walks as their dependencies allow, and with --no-pass-fusion, a walk per pass.
+//  Prints the walks, the CPU time and the heap allocations of semantic analysis in both
+//  modes, keeping the best of several runs, and how much CPU time fusion saved.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+#define SIZES_MAX			16
+#define RUNS_DEFAULT		3
+
+//
+// Semantic analysis figures of a run
+//
+struct analysis
+{
+	int walks;
+	double cpu_ms;
+	double allocations;
+};
+
+//
+// Run a program with its output sent to a file; returns its exit code, or -1 if it
+// could not run or was killed
+//
+static int run (char **argv, const char *output)
+{
+	posix_spawn_file_actions_t actions;
+	pid_t pid;
+	int status, rc;
+
+	posix_spawn_file_actions_init (&actions);
+	posix_spawn_file_actions_addopen (&actions, 1, output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	posix_spawn_file_actions_adddup2 (&actions, 1, 2);
+	rc = posix_spawn (&pid, argv[0], &actions, NULL, argv, environ);
+	posix_spawn_file_actions_destroy (&actions);
+	if (rc != 0 || waitpid (pid, &status, 0) < 0)
+	{
+		return -1;
+	}
+
+	return (WIFEXITED (status) ? WEXITSTATUS (status) : -1);
+}
+
+//
+// Get a number following a JSON key on a line
+//
+static double get_number (const char *line, const char *key)
+{
+	const char *found = strstr (line, key);
+	return (found != NULL ? atof (found + strlen (key)) : 0.0);
+}
+
+//
+// Read semantic analysis out of a time report; every phase is on a line of its own,
+// indented by its nesting, and the walks are the phases right below it
+//
+static int read_report (const char *file, struct analysis *result)
+{
+	char line[1024];
+	size_t depth = 0;
+	FILE *report = fopen (file, "r");
+	if (report == NULL)
+	{
+		return -1;
+	}
+
+	result->walks = -1;
+	while (fgets (line, sizeof (line), report) != NULL)
+	{
+		size_t indent = strspn (line, " ");
+		if (strstr (line, "\"name\": ") == NULL)
+		{
+			continue;
+		}
+
+		if (result->walks < 0)
+		{
+			if (strstr (line, "\"name\": \"semantic analysis\"") != NULL)
+			{
+				depth = indent;
+				result->walks = 0;
+				result->cpu_ms = get_number (line, "\"cpu_ms\": ");
+				result->allocations = get_number (line, "\"allocations\": ");
+			}
+		}
+		else if (indent > depth)
+		{
+			result->walks += (indent == depth + 2);
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	fclose (report);
+	return (result->walks < 0 ? -1 : 0);
+}
+
+//
+// Check a program several times and keep the best run
+//
+static int check (const char *cbasic, const char *source, const char *output, int fused, int runs, struct analysis *best)
+{
+	char report[80], log[80];
+	struct analysis result;
+	int i;
+
+	snprintf (report, sizeof (report), "%s.time.json", output);
+	snprintf (log, sizeof (log), "%s.log", output);
+
+	for (i = 0; i < runs; i ++)
+	{
+		char *args[] = { (char *) cbasic, "--check", "--time-report=json", "-o", (char *) output, (char *) source, NULL, NULL };
+		if (!fused)
+		{
+			args[6] = "--no-pass-fusion";
+		}
+		if (run (args, log) != 0 || read_report (report, &result) != 0)
+		{
+			fprintf (stderr, "%s: failed to check %s, see %s\n", cbasic, source, log);
+			return -1;
+		}
+		if (i == 0 || result.cpu_ms < best->cpu_ms)
+		{
+			*best = result;
+		}
+	}
+
+	return 0;
+}
+
+static void usage (const char *name)
+{
+	fprintf (stderr, "usage: %s [-r RUNS] CBASIC GENERATOR [LINES...] [-- GENERATOR OPTIONS...]\n", name);
+	fprintf (stderr, "  -r RUNS     runs of every check (default %d)\n", RUNS_DEFAULT);
+	fprintf (stderr, "  LINES       program sizes (default 10000 100000 1000000)\n");
+}
+
+int main (int argc, char **argv)
+{
+	static const unsigned int default_sizes[] = { 10000, 100000, 1000000 };
+	unsigned int sizes[SIZES_MAX];
+	int size_count = 0;
+	char *generator_args[64];
+	int generator_argc = 0;
+	int runs = RUNS_DEFAULT;
+	int i, c;
+
+	while ((c = getopt (argc, argv, "+r:")) != -1)
+	{
+		if (c != 'r')
+		{
+			usage (argv[0]);
+			return 2;
+		}
+		runs = atoi (optarg);
+	}
+	if (argc - optind < 2 || runs < 1)
+	{
+		usage (argv[0]);
+		return 2;
+	}
+	const char *cbasic = argv[optind];
+	const char *generator = argv[optind + 1];
+
+	// Sizes and generator options
+	for (i = optind + 2; i < argc && strcmp (argv[i], "--") != 0; i ++)
+	{
+		if (size_count < SIZES_MAX)
+		{
+			sizes[size_count ++] = strtoul (argv[i], NULL, 10);
+		}
+	}
+	if (size_count == 0)
+	{
+		memcpy (sizes, default_sizes, sizeof (default_sizes));
+		size_count = sizeof (default_sizes) / sizeof (default_sizes[0]);
+	}
+	generator_args[generator_argc ++] = (char *) generator;
+	generator_args[generator_argc ++] = "-n";
+	generator_args[generator_argc ++] = NULL;
+	for (i ++; i < argc && generator_argc < 62; i ++)
+	{
+		generator_args[generator_argc ++] = argv[i];
+	}
+	generator_args[generator_argc] = NULL;
+
+	printf ("%10s %16s %12s %14s %16s %12s %14s %10s\n", "lines", "separate walks", "CPU ms", "allocations",
+			"fused walks", "CPU ms", "allocations", "CPU saved");
+	for (i = 0; i < size_count; i ++)
+	{
+		char lines[16], source[64], output[64];
+		struct analysis separate, fused;
+
+		snprintf (lines, sizeof (lines), "%u", sizes[i]);
+		snprintf (source, sizeof (source), "passes-%u.bas", sizes[i]);
+		snprintf (output, sizeof (output), "passes-%u", sizes[i]);
+
+		generator_args[2] = lines;
+		if (run (generator_args, source) != 0)
+		{
+			fprintf (stderr, "%s: failed to generate %u lines\n", generator, sizes[i]);
+			return 2;
+		}
+
+		if (check (cbasic, source, output, 0, runs, &separate) != 0
+			|| check (cbasic, source, output, 1, runs, &fused) != 0)
+		{
+			return 1;
+		}
+
+		printf ("%10u %16d %12.1f %14.0f %16d %12.1f %14.0f %9.1f%%\n", sizes[i],
+				separate.walks, separate.cpu_ms, separate.allocations,
+				fused.walks, fused.cpu_ms, fused.allocations,
+				separate.cpu_ms > 0 ? 100.0 * (separate.cpu_ms - fused.cpu_ms) / separate.cpu_ms : 0.0);
+		fflush (stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,266 @@
+//
+// Synthetic BASIC program generator for the compiler throughput benchmark
+//  Prints a program of the requested number of lines to stdout. The program first
+//  assigns all of its variables, then mixes assignments and prints of integer, float
+//  and string expressions inside while and if blocks nested up to the given depth.
+//  The same options and seed always give the same program. Programs are meant to be
+//  compiled, not run: nested loops multiply the work of their bodies.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+//
+// Expression and statement types
+//
+#define TYPE_INT		0
+#define TYPE_FLOAT		1
+#define TYPE_STRING		2
+
+//
+// Chance in percent of opening and of closing a block on a line
+//
+#define BLOCK_OPEN		8
+#define BLOCK_CLOSE		8
+
+//
+// Deepest supported nesting
+//
+#define DEPTH_MAX		64
+
+static unsigned int lines = 1000;
+static unsigned int depth_max = 3;
+static unsigned int identifiers = 50;
+static unsigned int string_percent = 20;
+static unsigned int float_percent = 30;
+static unsigned int expression_size = 4;
+static unsigned long long seed = 1;
+
+//
+// Deterministic across C libraries (xorshift64)
+//
+static unsigned int random_below (unsigned int bound)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+	return (unsigned int) (seed % bound);
+}
+
+static int random_type ()
+{
+	unsigned int r = random_below (100);
+	if (r < string_percent)
+	{
+		return TYPE_STRING;
+	}
+	if (r < string_percent + float_percent)
+	{
+		return TYPE_FLOAT;
+	}
+	return TYPE_INT;
+}
+
+static void print_variable (int type, unsigned int index)
+{
+	switch (type)
+	{
+		case TYPE_INT:		printf ("i%u%%", index); break;
+		case TYPE_FLOAT:	printf ("f%u", index); break;
+		case TYPE_STRING:	printf ("s%u$", index); break;
+	}
+}
+
+static void print_operand (int type)
+{
+	if (random_below (3) == 0)
+	{
+		// Literal
+		switch (type)
+		{
+			case TYPE_INT:		printf ("%u", 1 + random_below (1000)); break;
+			case TYPE_FLOAT:	printf ("%u.%u", random_below (100), 1 + random_below (9)); break;
+			case TYPE_STRING:	printf ("\"w%u\"", random_below (1000)); break;
+		}
+	}
+	else
+	{
+		print_variable (type, random_below (identifiers));
+	}
+}
+
+//
+// Print an expression of the given number of operands, split at a random point
+//
+static void print_expression (int type, unsigned int size, int parenthesize)
+{
+	static const char *int_operators[] = { "+", "-", "*", "and", "or", "xor" };
+	static const char *float_operators[] = { "+", "-", "*" };
+	unsigned int left;
+
+	if (size <= 1)
+	{
+		print_operand (type);
+		return;
+	}
+
+	left = 1 + random_below (size - 1);
+	if (parenthesize)
+	{
+		printf ("(");
+	}
+	print_expression (type, left, 1);
+	switch (type)
+	{
+		case TYPE_INT:		printf (" %s ", int_operators[random_below (6)]); break;
+		case TYPE_FLOAT:	printf (" %s ", float_operators[random_below (3)]); break;
+		case TYPE_STRING:	printf (" + "); break;
+	}
+	print_expression (type, size - left, 1);
+	if (parenthesize)
+	{
+		printf (")");
+	}
+}
+
+static void print_indent (unsigned int depth)
+{
+	unsigned int i;
+	for (i = 0; i < depth; i ++)
+	{
+		printf ("\t");
+	}
+}
+
+static void usage (const char *name)
+{
+	fprintf (stderr, "usage: %s [-n LINES] [-d DEPTH] [-i IDENTIFIERS] [-s STRING%%] [-f FLOAT%%] [-e OPERANDS] [-r SEED]\n", name);
+	fprintf (stderr, "  -n LINES        lines of the program (default 1000)\n");
+	fprintf (stderr, "  -d DEPTH        deepest nesting of while and if blocks (default 3)\n");
+	fprintf (stderr, "  -i IDENTIFIERS  variables of each type (default 50)\n");
+	fprintf (stderr, "  -s STRING%%      share of string statements (default 20)\n");
+	fprintf (stderr, "  -f FLOAT%%       share of float statements (default 30)\n");
+	fprintf (stderr, "  -e OPERANDS     operands per expression (default 4)\n");
+	fprintf (stderr, "  -r SEED         random seed (default 1)\n");
+}
+
+int main (int argc, char **argv)
+{
+	// Kind of every open block, 0 for while and 1 for if, and the statements in it
+	int blocks[DEPTH_MAX];
+	unsigned int statements[DEPTH_MAX];
+	unsigned int depth = 0, line = 0, i;
+	int c;
+
+	while ((c = getopt (argc, argv, "n:d:i:s:f:e:r:")) != -1)
+	{
+		switch (c)
+		{
+			case 'n': lines = strtoul (optarg, NULL, 10); break;
+			case 'd': depth_max = strtoul (optarg, NULL, 10); break;
+			case 'i': identifiers = strtoul (optarg, NULL, 10); break;
+			case 's': string_percent = strtoul (optarg, NULL, 10); break;
+			case 'f': float_percent = strtoul (optarg, NULL, 10); break;
+			case 'e': expression_size = strtoul (optarg, NULL, 10); break;
+			case 'r': seed = strtoull (optarg, NULL, 10); break;
+			default:
+				usage (argv[0]);
+				return 1;
+		}
+	}
+	if (identifiers == 0 || expression_size == 0 || depth_max > DEPTH_MAX || string_percent + float_percent > 100 || seed == 0)
+	{
+		usage (argv[0]);
+		return 1;
+	}
+
+	// Every variable is assigned before it is used
+	for (i = 0; i < 3 * identifiers && line < lines; i ++, line ++)
+	{
+		printf ("let ");
+		print_variable (i % 3, i / 3);
+		switch (i % 3)
+		{
+			case TYPE_INT:		printf (" = %u\n", i); break;
+			case TYPE_FLOAT:	printf (" = %u.5\n", i); break;
+			case TYPE_STRING:	printf (" = \"v%u\"\n", i); break;
+		}
+	}
+
+	// Body; every open block needs two lines to close, a while loop its counter too
+	while (line < lines)
+	{
+		unsigned int closing = 0;
+		for (i = 0; i < depth; i ++)
+		{
+			closing += (blocks[i] == 0 ? 2 : 1);
+		}
+
+		// Blocks are never left empty
+		if (depth > 0 && (line + closing >= lines || (statements[depth - 1] > 0 && random_below (100) < BLOCK_CLOSE)))
+		{
+			depth --;
+			if (blocks[depth] == 0)
+			{
+				print_indent (depth + 1);
+				printf ("let w%u%% = w%u%% + 1\n", depth, depth);
+				print_indent (depth);
+				printf ("wend\n");
+				line += 2;
+			}
+			else
+			{
+				print_indent (depth);
+				printf ("endif\n");
+				line ++;
+			}
+			continue;
+		}
+
+		if (depth > 0)
+		{
+			statements[depth - 1] ++;
+		}
+
+		print_indent (depth);
+		if (depth < depth_max && line + closing + 4 < lines && random_below (100) < BLOCK_OPEN)
+		{
+			blocks[depth] = random_below (2);
+			if (blocks[depth] == 0)
+			{
+				printf ("let w%u%% = 0\n", depth);
+				print_indent (depth);
+				printf ("while w%u%% < 2\n", depth);
+				line += 2;
+			}
+			else
+			{
+				printf ("if ");
+				print_expression (TYPE_INT, expression_size, 0);
+				printf (" > 0 then\n");
+				line ++;
+			}
+			statements[depth] = 0;
+			depth ++;
+		}
+		else
+		{
+			int type = random_type ();
+			if (random_below (4) == 0)
+			{
+				printf ("print ");
+			}
+			else
+			{
+				printf ("let ");
+				print_variable (type, random_below (identifiers));
+				printf (" = ");
+			}
+			print_expression (type, expression_size, 0);
+			printf ("\n");
+			line ++;
+		}
+	}
+
+	return 0;
+}
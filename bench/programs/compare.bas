@@ -0,0 +1,18 @@
+let a$ = "the quick brown fox jumps over the lazy dog"
+let b$ = "the quick brown fox jumps over the lazy cat"
+let c$ = "short"
+let matches% = 0
+let i% = 0
+while i% < 8000000
+	if a$ > b$ then
+		let matches% = matches% + 1
+	endif
+	if c$ < a$ and i% mod 3 = 0 then
+		let matches% = matches% + 1
+	endif
+	if i% * 2 >= 8000000 or i% < 10 then
+		let matches% = matches% + 1
+	endif
+	let i% = i% + 1
+wend
+print matches%
@@ -0,0 +1,9 @@
+let sum = 0.0
+let x = 0.0
+let i% = 0
+while i% < 20000000
+	let x = x + 0.0000005
+	let sum = sum + x * x / (1.0 + x) - x / 3.0
+	let i% = i% + 1
+wend
+print sum
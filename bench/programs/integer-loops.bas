@@ -0,0 +1,11 @@
+let total% = 0
+let i% = 0
+while i% < 8000
+	let j% = 0
+	while j% < 5000
+		let total% = total% + (i% * j%) mod 7 - j% \ 3
+		let j% = j% + 1
+	wend
+	let i% = i% + 1
+wend
+print total%
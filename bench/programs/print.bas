@@ -0,0 +1,7 @@
+let x = 0.5
+let i% = 0
+while i% < 1000000
+	print i%, " ", x, " ", "text"
+	let x = x + 1.25
+	let i% = i% + 1
+wend
@@ -0,0 +1,16 @@
+let lines% = 0
+let i% = 0
+while i% < 200000
+	let line$ = ""
+	let j% = 0
+	while j% < 40
+		let line$ = line$ + "ab"
+		let j% = j% + 1
+	wend
+	let line$ = "line " + line$ + " end"
+	if line$ <> "" then
+		let lines% = lines% + 1
+	endif
+	let i% = i% + 1
+wend
+print lines%
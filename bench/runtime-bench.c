@@ -0,0 +1,237 @@
+//
+// Runtime benchmark for compiled programs
+//  Runs every executable given on the command line several times and reports the
+//  best and median wall time, the instructions retired (where perf counters are
+//  available) and the output bytes per second. Output is read through a pipe and
+//  discarded. With -o the results are appended to a CSV file under a label naming
+//  the compiler version and options, so that runs of different compilers can be
+//  compared.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#define RUNS_DEFAULT		5
+#define RUNS_MAX			100
+
+//
+// Results of a single run
+//
+struct run_result
+{
+	double seconds;
+	long long instructions;
+	unsigned long long output_bytes;
+};
+
+static double now ()
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//
+// Open an instruction counter for a process that has not called exec yet; it starts
+// counting at exec. Returns -1 if perf counters are not available.
+//
+static int open_counter (pid_t pid)
+{
+#ifdef __linux__
+	struct perf_event_attr attr;
+	memset (&attr, 0, sizeof (attr));
+	attr.size = sizeof (attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.disabled = 1;
+	attr.enable_on_exec = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall (SYS_perf_event_open, &attr, pid, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+static int compare_doubles (const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+//
+// Run an executable once; returns 0 if it exited with 0
+//
+static int run (const char *path, struct run_result *result)
+{
+	int go[2], output[2], counter, status;
+	char buffer[65536], c = 0;
+	ssize_t length;
+	double start;
+	pid_t pid;
+
+	if (pipe (go) != 0 || pipe (output) != 0)
+	{
+		return -1;
+	}
+
+	pid = fork ();
+	if (pid < 0)
+	{
+		return -1;
+	}
+	if (pid == 0)
+	{
+		// Wait for the counter to be attached
+		char *argv[] = { (char *) path, NULL };
+		close (go[1]);
+		close (output[0]);
+		if (read (go[0], &c, 1) != 1)
+		{
+			_exit (127);
+		}
+		dup2 (output[1], 1);
+		execv (path, argv);
+		_exit (127);
+	}
+	close (go[0]);
+	close (output[1]);
+
+	counter = open_counter (pid);
+	start = now ();
+	if (write (go[1], &c, 1) != 1)
+	{
+		return -1;
+	}
+	close (go[1]);
+
+	result->output_bytes = 0;
+	while ((length = read (output[0], buffer, sizeof (buffer))) > 0)
+	{
+		result->output_bytes += length;
+	}
+	close (output[0]);
+	waitpid (pid, &status, 0);
+	result->seconds = now () - start;
+
+	result->instructions = -1;
+	if (counter >= 0)
+	{
+		long long count;
+		if (read (counter, &count, sizeof (count)) == sizeof (count))
+		{
+			result->instructions = count;
+		}
+		close (counter);
+	}
+
+	return (WIFEXITED (status) && WEXITSTATUS (status) == 0 ? 0 : -1);
+}
+
+static void usage (const char *name)
+{
+	fprintf (stderr, "usage: %s [-r RUNS] [-o RESULTS.csv] [-l LABEL] EXECUTABLE...\n", name);
+	fprintf (stderr, "  -r RUNS     runs of every executable (default %d)\n", RUNS_DEFAULT);
+	fprintf (stderr, "  -o FILE     append the results to a CSV file\n");
+	fprintf (stderr, "  -l LABEL    label of the results in the CSV file, e.g. compiler version and options\n");
+}
+
+int main (int argc, char **argv)
+{
+	struct run_result results[RUNS_MAX];
+	double seconds[RUNS_MAX];
+	const char *csv_file = NULL, *label = "";
+	FILE *csv = NULL;
+	int runs = RUNS_DEFAULT, failed = 0;
+	int i, j, c;
+
+	while ((c = getopt (argc, argv, "r:o:l:")) != -1)
+	{
+		switch (c)
+		{
+			case 'r': runs = atoi (optarg); break;
+			case 'o': csv_file = optarg; break;
+			case 'l': label = optarg; break;
+			default:
+				usage (argv[0]);
+				return 1;
+		}
+	}
+	if (optind == argc || runs < 1 || runs > RUNS_MAX)
+	{
+		usage (argv[0]);
+		return 1;
+	}
+
+	if (csv_file != NULL)
+	{
+		csv = fopen (csv_file, "a");
+		if (csv == NULL)
+		{
+			fprintf (stderr, "cannot open '%s'\n", csv_file);
+			return 1;
+		}
+		fseek (csv, 0, SEEK_END);
+		if (ftell (csv) == 0)
+		{
+			fprintf (csv, "label,program,runs,best_ms,median_ms,instructions,output_bytes,output_mb_per_s\n");
+		}
+	}
+
+	printf ("%-32s %10s %10s %16s %12s %10s\n", "program", "best ms", "median ms", "instructions", "output B", "out MB/s");
+	for (i = optind; i < argc; i ++)
+	{
+		const char *program = strrchr (argv[i], '/') != NULL ? strrchr (argv[i], '/') + 1 : argv[i];
+		char instructions[32];
+		double best, median, rate;
+
+		// Warm up the page cache
+		if (run (argv[i], &results[0]) != 0)
+		{
+			fprintf (stderr, "%s: failed to run\n", argv[i]);
+			failed = 1;
+			continue;
+		}
+
+		for (j = 0; j < runs; j ++)
+		{
+			run (argv[i], &results[j]);
+			seconds[j] = results[j].seconds;
+		}
+		qsort (seconds, runs, sizeof (double), compare_doubles);
+		best = seconds[0];
+		median = seconds[runs / 2];
+
+		// Instructions retired don't depend on the run, output neither
+		rate = results[0].output_bytes / best / 1e6;
+		if (results[0].instructions >= 0)
+		{
+			snprintf (instructions, sizeof (instructions), "%lld", results[0].instructions);
+		}
+		else
+		{
+			strcpy (instructions, "n/a");
+		}
+
+		printf ("%-32s %10.2f %10.2f %16s %12llu %10.2f\n", program, best * 1e3, median * 1e3,
+				instructions, results[0].output_bytes, rate);
+		if (csv != NULL)
+		{
+			fprintf (csv, "%s,%s,%d,%.3f,%.3f,%s,%llu,%.3f\n", label, program, runs, best * 1e3, median * 1e3,
+					 results[0].instructions >= 0 ? instructions : "", results[0].output_bytes, rate);
+		}
+	}
+
+	if (csv != NULL)
+	{
+		fclose (csv);
+	}
+	return failed;
+}
@@ -0,0 +1,82 @@
+//
+// Process startup benchmark for compiled programs
+//  Runs every executable given on the command line many times, with its output
+//  sent to /dev/null, and reports the average wall time per run. Meant to compare
+//  dynamically linked programs against static ones (cbasic --static).
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+#define RUNS			2000
+
+static double now ()
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int run (const char *path, posix_spawn_file_actions_t *actions)
+{
+	char *argv[] = { (char *) path, NULL };
+	pid_t pid;
+	int status;
+
+	if (posix_spawn (&pid, path, actions, NULL, argv, environ) != 0)
+	{
+		return -1;
+	}
+	if (waitpid (pid, &status, 0) < 0 || !WIFEXITED (status))
+	{
+		return -1;
+	}
+
+	return WEXITSTATUS (status);
+}
+
+int main (int argc, char **argv)
+{
+	posix_spawn_file_actions_t actions;
+	double start, elapsed;
+	int i, j;
+
+	if (argc < 2)
+	{
+		fprintf (stderr, "usage: %s EXECUTABLE...\n", argv[0]);
+		return 1;
+	}
+
+	// Discard program output
+	posix_spawn_file_actions_init (&actions);
+	posix_spawn_file_actions_addopen (&actions, 1, "/dev/null", O_WRONLY, 0);
+
+	for (i = 1; i < argc; i ++)
+	{
+		// Warm up the page cache
+		if (run (argv[i], &actions) != 0)
+		{
+			fprintf (stderr, "%s: failed to run\n", argv[i]);
+			return 1;
+		}
+
+		start = now ();
+		for (j = 0; j < RUNS; j ++)
+		{
+			run (argv[i], &actions);
+		}
+		elapsed = now () - start;
+
+		printf ("%-40s %8.1f us/run\n", argv[i], elapsed * 1e6 / RUNS);
+	}
+
+	posix_spawn_file_actions_destroy (&actions);
+	return 0;
+}
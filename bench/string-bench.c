@@ -0,0 +1,199 @@
+//
+// Microbenchmark for the runtime library string routines
+//  Compares the SSE2 _str_copy, _str_concat, _str_compare and _str_equal on string
+//  descriptors against the scalar routines the backend used to emit on NUL
+//  terminated strings, and checks that both agree.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STRING_SIZE		256
+#define STRING_INLINE_MAX	12
+#define STRINGS			64
+#define ITERATIONS		200000
+
+//
+// String descriptor, as laid out by the runtime library
+//
+struct string
+{
+	unsigned int length;
+	union
+	{
+		char inline_chars[STRING_INLINE_MAX];
+		struct
+		{
+			char *chars;
+			unsigned int storage;
+		};
+	};
+} __attribute__ ((aligned (16)));
+
+static const char *string_chars (const struct string *str)
+{
+	return (str->length > STRING_INLINE_MAX ? str->chars : str->inline_chars);
+}
+
+// Releases concatenation results
+extern int _str_arena_reset ();
+
+//
+// String routines take their parameters in EBX, ECX and EDX
+//
+#define DEFINE_COPY(name, type) \
+	static void name##_call (type *dest, const type *src) \
+	{ \
+		__asm__ volatile ("call " #name : "+b" (dest), "+c" (src) : : "eax", "edx", "xmm0", "xmm1", "memory"); \
+	}
+
+#define DEFINE_CONCAT(name, type) \
+	static void name##_call (type *dest, const type *s1, const type *s2) \
+	{ \
+		__asm__ volatile ("call " #name : "+b" (dest), "+c" (s1), "+d" (s2) : : "eax", "xmm0", "xmm7", "memory"); \
+	}
+
+#define DEFINE_COMPARE(name, type) \
+	static int name##_call (const type *s1, const type *s2) \
+	{ \
+		int result; \
+		__asm__ volatile ("call " #name : "=a" (result), "+b" (s1), "+c" (s2) \
+						  : : "edx", "xmm0", "xmm1", "xmm2", "xmm7", "memory"); \
+		return result; \
+	}
+
+DEFINE_COPY (_str_copy, struct string)
+DEFINE_COPY (_str_copy_scalar, char)
+DEFINE_CONCAT (_str_concat, struct string)
+DEFINE_CONCAT (_str_concat_scalar, char)
+DEFINE_COMPARE (_str_compare, struct string)
+DEFINE_COMPARE (_str_compare_scalar, char)
+DEFINE_COMPARE (_str_equal, struct string)
+
+// Descriptors and NUL terminated copies of the same strings
+static struct string strings[STRINGS];
+static char chars[STRINGS][STRING_SIZE];
+static char cstrings[STRINGS][STRING_SIZE] __attribute__ ((aligned (16)));
+static struct string dest;
+static char cdest[STRING_SIZE * 2] __attribute__ ((aligned (16)));
+
+static double now ()
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report (const char *name, double seconds)
+{
+	printf ("%-24s %8.2f ns/call\n", name, seconds * 1e9 / ((double) ITERATIONS * STRINGS));
+}
+
+int main ()
+{
+	unsigned int seed = 12345, mismatches = 0;
+	unsigned int checksum = 0;
+	double start;
+	int i, j;
+
+	// Strings of every length class, sharing long prefixes so comparisons scan far
+	for (i = 0; i < STRINGS; i ++)
+	{
+		int length = (i * 37) % 256;
+		for (j = 0; j < length; j ++)
+		{
+			seed = seed * 1103515245 + 12345;
+			cstrings[i][j] = (i % 4 == 0 ? 'a' + ((seed >> 16) % 26) : 'a' + j % 26);
+		}
+		cstrings[i][length] = 0;
+		strings[i].length = length;
+		if (length > STRING_INLINE_MAX)
+		{
+			memcpy (chars[i], cstrings[i], length);
+			strings[i].chars = chars[i];
+		}
+		else
+		{
+			memcpy (strings[i].inline_chars, cstrings[i], length);
+		}
+	}
+
+	// Copy
+	start = now ();
+	for (i = 0; i < ITERATIONS; i ++)
+		for (j = 0; j < STRINGS; j ++)
+			_str_copy_call (&dest, &strings[j]);
+	report ("_str_copy", now () - start);
+
+	start = now ();
+	for (i = 0; i < ITERATIONS; i ++)
+		for (j = 0; j < STRINGS; j ++)
+			_str_copy_scalar_call (cdest, cstrings[j]);
+	report ("_str_copy_scalar", now () - start);
+
+	// Concatenation
+	start = now ();
+	for (i = 0; i < ITERATIONS; i ++)
+	{
+		for (j = 0; j < STRINGS; j ++)
+		{
+			struct string result;
+			_str_concat_call (&result, &strings[j], &strings[(j + 1) % STRINGS]);
+		}
+		_str_arena_reset ();
+	}
+	report ("_str_concat", now () - start);
+
+	start = now ();
+	for (i = 0; i < ITERATIONS; i ++)
+		for (j = 0; j < STRINGS; j ++)
+			_str_concat_scalar_call (cdest, cstrings[j], cstrings[(j + 1) % STRINGS]);
+	report ("_str_concat_scalar", now () - start);
+
+	// Comparison
+	start = now ();
+	for (i = 0; i < ITERATIONS; i ++)
+		for (j = 0; j < STRINGS; j ++)
+			checksum += _str_compare_call (&strings[j], &strings[(j + 4) % STRINGS]);
+	report ("_str_compare", now () - start);
+
+	start = now ();
+	for (i = 0; i < ITERATIONS; i ++)
+		for (j = 0; j < STRINGS; j ++)
+			checksum += _str_compare_scalar_call (cstrings[j], cstrings[(j + 4) % STRINGS]);
+	report ("_str_compare_scalar", now () - start);
+
+	// Equality
+	start = now ();
+	for (i = 0; i < ITERATIONS; i ++)
+		for (j = 0; j < STRINGS; j ++)
+			checksum += _str_equal_call (&strings[j], &strings[(j + 4) % STRINGS]);
+	report ("_str_equal", now () - start);
+
+	// Both implementations must agree, concatenation is no longer truncated
+	for (i = 0; i < STRINGS; i ++)
+	{
+		for (j = 0; j < STRINGS; j ++)
+		{
+			int expected = _str_compare_scalar_call (cstrings[i], cstrings[j]);
+			struct string result;
+
+			strcpy (cdest, cstrings[i]);
+			strcat (cdest, cstrings[j]);
+			_str_concat_call (&result, &strings[i], &strings[j]);
+			_str_copy_call (&dest, &result);
+			if (dest.length != strlen (cdest)
+				|| memcmp (string_chars (&dest), cdest, dest.length) != 0
+				|| _str_compare_call (&strings[i], &strings[j]) != expected
+				|| (_str_equal_call (&strings[i], &strings[j]) == 2) != (expected == 2))
+			{
+				mismatches ++;
+			}
+			_str_arena_reset ();
+		}
+	}
+	printf ("mismatches: %u (checksum %u)\n", mismatches, checksum);
+
+	return (mismatches == 0 ? 0 : 1);
+}
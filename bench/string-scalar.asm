@@ -0,0 +1,72 @@
+; Scalar string routines, as previously emitted by the x86-nasm backend
+; Used as the baseline of string-bench.c
+global _str_copy_scalar
+global _str_concat_scalar
+global _str_compare_scalar
+
+section .text
+
+; EBX holds destination pointer
+; ECX holds source pointer
+_str_copy_scalar:
+  mov al, byte [ecx]
+  mov byte [ebx], al
+  inc ebx
+  inc ecx
+  test al, al
+  jnz _str_copy_scalar
+  mov eax, 0
+  ret
+
+; EBX holds destination pointer
+; ECX holds str1 pointer
+; EDX holds str2 pointer
+_str_concat_scalar:
+  mov eax, 0xFF00
+.copy_s1:
+  mov al, byte [ecx]
+  test al, al
+  jz .copy_s2
+  test ah, ah
+  jz .done
+  mov byte [ebx], al
+  dec ah
+  inc ebx
+  inc ecx
+  jmp .copy_s1
+.copy_s2:
+  mov al, byte [edx]
+  mov byte [ebx], al
+  test al, al
+  jz .done
+  test ah, ah
+  jz .done
+  dec ah
+  inc ebx
+  inc edx
+  jmp .copy_s2
+.done:
+  mov eax, 0
+  mov byte [ebx], al
+  ret
+
+; EBX holds str1 pointer
+; ECX holds str2 pointer
+; Return in EAX: 3 if str1 < str2; 2 if str1 == str2; 1 if str1 > str2
+_str_compare_scalar:
+  mov al, byte [ebx]
+  cmp al, byte [ecx]
+  jl .s2_larger
+  jg .s1_larger
+  inc ebx
+  inc ecx
+  test al, al
+  jnz _str_compare_scalar
+  mov eax, 2
+  ret
+.s1_larger:
+  mov eax, 1
+  ret
+.s2_larger:
+  mov eax, 3
+  ret
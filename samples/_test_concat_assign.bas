@@ -0,0 +1,44 @@
+let s$ = "0123456789abcdef"
+let s$ = s$ + "-"
+let s$ = s$ + "x" + s$
+print s$
+
+let a$ = "prefix "
+let s$ = a$ + s$
+print s$
+
+let s$ = s$ + s$ + "."
+print s$
+
+let t$ = s$
+let s$ = s$ + "!"
+print s$
+print t$
+
+let t$ = t$ + "?"
+print t$
+print s$
+
+let u$ = t$
+let t$ = t$ + u$
+print t$
+print u$
+
+let c$ = "ab"
+let c$ = c$ + "cd" + c$
+print c$
+let c$ = "x" + c$ + c$
+print c$
+let c$ = c$ + "y" + c$
+print c$
+
+let g$ = "0123456789abc"
+let g$ = g$ + "d"
+let i% = 0
+while i% < 3
+	let h$ = g$
+	let g$ = g$ + "." + g$
+	print h$
+	let i% = i% + 1
+wend
+print g$
@@ -0,0 +1,42 @@
+let foo$ = "foo"
+let bar$ = "bar"
+let x$ = "x"
+let y$ = "y"
+let long1$ = "a string longer than twelve characters"
+let long2$ = " and another one"
+
+print "foo" + "bar"
+print foo$ + bar$
+print foo$ + "x" + "y"
+print foo$ + x$ + y$
+print "x" + ("y" + foo$)
+print x$ + (y$ + foo$)
+print "x" + foo$ + "y" + "x" + bar$ + "y"
+print x$ + foo$ + y$ + x$ + bar$ + y$
+print "a string longer than twelve characters" + " and another one"
+print long1$ + long2$
+print "twelve characters"
+print "longer than twelve" + "" + " characters"
+print long1$ + "" + long2$
+
+let e$ = ""
+let abc$ = "abc"
+let abd$ = "abd"
+let ab$ = "ab"
+let upper$ = "ABC"
+let high$ = "é"
+let low$ = "e"
+
+print "abc" < "abd", " ", "abc" > "abd", " ", "abc" <= "abd", " ", "abc" >= "abd", " ", "abc" = "abd", " ", "abc" <> "abd"
+print abc$ < abd$, " ", abc$ > abd$, " ", abc$ <= abd$, " ", abc$ >= abd$, " ", abc$ = abd$, " ", abc$ <> abd$
+print "ab" < "abc", " ", "ab" > "abc", " ", "ab" <= "abc", " ", "ab" >= "abc", " ", "ab" = "abc", " ", "ab" <> "abc"
+print ab$ < abc$, " ", ab$ > abc$, " ", ab$ <= abc$, " ", ab$ >= abc$, " ", ab$ = abc$, " ", ab$ <> abc$
+print "abc" < "abc", " ", "abc" > "abc", " ", "abc" <= "abc", " ", "abc" >= "abc", " ", "abc" = "abc", " ", "abc" <> "abc"
+print abc$ < abc$, " ", abc$ > abc$, " ", abc$ <= abc$, " ", abc$ >= abc$, " ", abc$ = abc$, " ", abc$ <> abc$
+print "" < "abc", " ", "" > "abc", " ", "" <= "abc", " ", "" >= "abc", " ", "" = "abc", " ", "" <> "abc"
+print e$ < abc$, " ", e$ > abc$, " ", e$ <= abc$, " ", e$ >= abc$, " ", e$ = abc$, " ", e$ <> abc$
+print "ABC" < "abc", " ", "ABC" > "abc", " ", "ABC" <= "abc", " ", "ABC" >= "abc", " ", "ABC" = "abc", " ", "ABC" <> "abc"
+print upper$ < abc$, " ", upper$ > abc$, " ", upper$ <= abc$, " ", upper$ >= abc$, " ", upper$ = abc$, " ", upper$ <> abc$
+print "é" < "e", " ", "é" > "e", " ", "é" <= "e", " ", "é" >= "e", " ", "é" = "e", " ", "é" <> "e"
+print high$ < low$, " ", high$ > low$, " ", high$ <= low$, " ", high$ >= low$, " ", high$ = low$, " ", high$ <> low$
+print "foo" + "bar" = "foobar", " ", foo$ + bar$ = "foo" + bar$
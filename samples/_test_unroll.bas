@@ -0,0 +1,71 @@
+let i% = 0
+while i% < 5
+	print "full ", i%
+	let i% = i% + 1
+wend
+print "after full ", i%
+
+let start% = 0
+let j% = start%
+while j% < 11
+	print "partial ", j%
+	let j% = j% + 1
+wend
+print "after partial ", j%
+
+let k% = start% + 1
+while k% <= 20
+	print "partial step ", k%
+	let k% = k% + 3
+wend
+print "after partial step ", k%
+
+let sum% = 0
+let n% = 0
+while n% < 1000
+	let sum% = sum% + n%
+	let n% = n% + 1
+wend
+print "long ", sum%, " ", n%
+
+let m% = 10
+while m% <> 0
+	print "not equal ", m%
+	let m% = m% - 2
+wend
+print "after not equal ", m%
+
+let p% = start% + 7
+while p% <> 0
+	print "partial not equal ", p%
+	let p% = p% - 1
+wend
+print "after partial not equal ", p%
+
+let d% = 9
+while d% >= 0
+	print "down ", d%
+	let d% = d% - 4
+wend
+print "after down ", d%
+
+let e% = start% + 10
+while e% > 0
+	print "partial down ", e%
+	let e% = e% - 3
+wend
+print "after partial down ", e%
+
+let f% = 2
+while 5 > f%
+	print "mirrored ", f%
+	let f% = 1 + f%
+wend
+print "after mirrored ", f%
+
+let z% = 10
+while z% < 5
+	print "never ", z%
+	let z% = z% + 1
+wend
+print "after never ", z%
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <string>
 #include "ilang/il-program.h"
+#include "compilation.h"
 
 //
 // Backend interface
@@ -11,11 +12,11 @@
 class Backend
 {
 public:
-	Backend () { }
 	virtual ~Backend () { }
 
-	// Compile an intermediate language program
-	virtual int compile (IlProgram *program, std::string output_file) = 0;
+	// Compile an intermediate language program; options and output streams are
+	// taken from the compilation
+	virtual int compile (Compilation *compilation, IlProgram *program) = 0;
 
 	// Get a backend instance for specified target
 	static Backend *getBackend (std::string target);
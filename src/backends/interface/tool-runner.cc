@@ -0,0 +1,130 @@
+#include "tool-runner.h"
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <spawn.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include "error/error.h"
+
+extern char **environ;
+
+int ToolRunner::run (const std::vector<std::string> &args, const std::vector<int> &files, ToolUsage &usage, std::string &messages)
+{
+	std::vector<char *> argv;
+	for (const std::string &arg : args)
+	{
+		argv.push_back ((char *) arg.c_str ());
+	}
+	argv.push_back (nullptr);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+
+	// Capture the tool's output in a private in-memory file, if supported
+	int output_fd = -1;
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init (&actions);
+#ifdef __linux__
+	output_fd = memfd_create (args[0].c_str (), MFD_CLOEXEC);
+	if (output_fd >= 0)
+	{
+		posix_spawn_file_actions_adddup2 (&actions, output_fd, 1);
+		posix_spawn_file_actions_adddup2 (&actions, output_fd, 2);
+	}
+#endif
+
+	// Files are duplicated above the numbers they get in the tool first, so that no
+	// file is overwritten by another one before it is moved to its place
+	std::vector<int> duplicates;
+	for (unsigned int i = 0; i < files.size (); i ++)
+	{
+		if (files[i] < 0)
+		{
+			continue;
+		}
+		int fd = fcntl (files[i], F_DUPFD_CLOEXEC, TOOL_FILE_DESCRIPTOR_BASE + files.size ());
+		if (fd < 0)
+		{
+			continue;
+		}
+		duplicates.push_back (fd);
+		posix_spawn_file_actions_adddup2 (&actions, fd, TOOL_FILE_DESCRIPTOR_BASE + i);
+	}
+
+	pid_t pid;
+	int rc = posix_spawnp (&pid, argv[0], &actions, nullptr, argv.data (), environ);
+	posix_spawn_file_actions_destroy (&actions);
+	for (int fd : duplicates)
+	{
+		close (fd);
+	}
+	if (rc != 0)
+	{
+		if (output_fd >= 0)
+		{
+			close (output_fd);
+		}
+		Error::internalError ("cannot run '" + args[0] + "': " + strerror (rc));
+		return ER_FAILED;
+	}
+
+	// Reaping the tool with wait4 gives its own resource usage, not that of all children
+	int status;
+	struct rusage resources;
+	while (wait4 (pid, &status, 0, &resources) < 0)
+	{
+		if (errno != EINTR)
+		{
+			Error::internalError ("cannot wait for '" + args[0] + "': " + strerror (errno));
+			if (output_fd >= 0)
+			{
+				close (output_fd);
+			}
+			return ER_FAILED;
+		}
+	}
+
+	usage.wall_us = std::chrono::duration_cast<std::chrono::microseconds> (std::chrono::steady_clock::now () - start).count ();
+	usage.cpu_us = resources.ru_utime.tv_sec * 1000000UL + resources.ru_utime.tv_usec
+				 + resources.ru_stime.tv_sec * 1000000UL + resources.ru_stime.tv_usec;
+	usage.peak_rss_kb = resources.ru_maxrss;
+
+	// Collect the output
+	messages.clear ();
+	if (output_fd >= 0)
+	{
+		char buffer[4096];
+		ssize_t length;
+		off_t offset = 0;
+		while ((length = pread (output_fd, buffer, sizeof (buffer), offset)) > 0)
+		{
+			messages.append (buffer, length);
+			offset += length;
+		}
+		close (output_fd);
+	}
+
+	if (!WIFEXITED (status))
+	{
+		Error::internalError ("'" + args[0] + "' was terminated by signal " + std::to_string (WTERMSIG (status)));
+		return ER_FAILED;
+	}
+
+	return WEXITSTATUS (status);
+}
+
+int ToolRunner::createMemoryFile (std::string name)
+{
+#ifdef __linux__
+	int fd = memfd_create (name.c_str (), MFD_CLOEXEC);
+	if (fd >= 0)
+	{
+		return fd;
+	}
+#endif
+
+	return ER_FAILED;
+}
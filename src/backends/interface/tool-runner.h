@@ -0,0 +1,47 @@
+#ifndef TOOL_RUNNER_H_
+#define TOOL_RUNNER_H_
+
+#include <string>
+#include <vector>
+
+//
+// Resources used by a tool run: wall time, user and system CPU time, and the tool's
+// peak resident set size
+//
+struct ToolUsage
+{
+	unsigned long wall_us;
+	unsigned long cpu_us;
+	unsigned long peak_rss_kb;
+
+	ToolUsage () : wall_us (0), cpu_us (0), peak_rss_kb (0) { }
+};
+
+//
+// First descriptor number under which a spawned tool gets the files passed to it
+//
+#define TOOL_FILE_DESCRIPTOR_BASE	3
+
+//
+// External tool invocation (assembler, linker)
+// Tools are spawned directly with an argument vector, no shell is involved
+//
+class ToolRunner
+{
+public:
+	// Run a tool, searched for in PATH, and wait for it; the resources it used are stored
+	// in usage and whatever it printed in messages, so that concurrent compilations don't
+	// mix their tool output. The descriptors in files (negative ones are skipped) are
+	// passed to the tool only, see getFilePath. Returns the exit code of the tool, or
+	// ER_FAILED if it could not be run
+	static int run (const std::vector<std::string> &args, const std::vector<int> &files, ToolUsage &usage, std::string &messages);
+
+	// Create an anonymous in-memory file, closed on exec so that tools spawned by other
+	// threads don't inherit it; returns the descriptor, or ER_FAILED if not supported
+	static int createMemoryFile (std::string name);
+
+	// Path under which a spawned tool opens the file passed to it at the given index
+	static std::string getFilePath (unsigned int index) { return "/proc/self/fd/" + std::to_string (TOOL_FILE_DESCRIPTOR_BASE + index); }
+};
+
+#endif
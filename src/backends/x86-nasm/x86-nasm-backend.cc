@@ -1,16 +1,60 @@
 #include "x86-nasm-backend.h"
 #include <cstdlib>
 #include <cassert>
+#include <unistd.h>
+#include "configure.h"
 #include "error/error.h"
 #include "ilang/il-address.h"
 #include "x86-nasm-primitives.h"
+#include "verbose.h"
+#include "backends/interface/tool-runner.h"
 
 //
 // Printing aliases
 //
-#define INDENT			"  "
 #define ENTRY_POINT		"main"
 
+//
+// In-memory files passed to the assembler, by index
+//
+#define NASM_FILE_ASSEMBLY	0
+#define NASM_FILE_OBJECT	1
+#define NASM_FILE_INCBIN	2
+#define NASM_FILE_COUNT		3
+
+//
+// Closes a descriptor on every way out of a scope
+//
+class DescriptorGuard
+{
+private:
+	int fd_;
+
+public:
+	DescriptorGuard (int fd) : fd_ (fd) { }
+	~DescriptorGuard () { if (fd_ >= 0) close (fd_); }
+};
+
+//
+// Deletes the instructions of a list on every way out of a scope
+//
+class InstructionListGuard
+{
+private:
+	NasmInstructionList &ilist_;
+
+public:
+	InstructionListGuard (NasmInstructionList &ilist) : ilist_ (ilist) { }
+	~InstructionListGuard ()
+	{
+		for (NasmInstruction *ins : ilist_)
+		{
+			delete ins;
+		}
+		ilist_.clear ();
+	}
+};
+
 //
 // Implementation of backend
 //
@@ -18,12 +62,16 @@ X86NasmBackend::X86NasmBackend ()
 {
 	NasmInstruction *ins;
 
+	compilation_ = nullptr;
+
 	// Create program exit instruction list
+	ins = new CallNasmInstruction ("_out_flush");
+	ins->setComment ("program exit point");
+	program_exit_.push_back (ins);
 	ins = new MovNasmInstruction (
 				new RegisterNasmAddress (REG_EAX),
 				new ImmediateNasmAddress ((unsigned int) 1)
 			);
-	ins->setComment ("program exit point");
 	program_exit_.push_back (ins);
 	ins = new MovNasmInstruction (
 				new RegisterNasmAddress (REG_EBX),
@@ -34,92 +82,14 @@ X86NasmBackend::X86NasmBackend ()
 	program_exit_.push_back (ins);
 }
 
-void X86NasmBackend::generateInternalFunctions (NasmInstructionList &ilist)
+X86NasmBackend::~X86NasmBackend ()
 {
-	//
-	//  Since we know what we are doing, we are not going to create a frame :)
-	//
-
-	//
-	// String copy
-	//  EBX holds destination pointer
-	//  ECX holds source pointer
-	//
-	ilist.push_back (new LabelNasmInstruction ("_str_copy"));
-	ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_AL), new MemoryBasedNasmAddress (REG_ECX, 0)));
-	ilist.push_back (new MovNasmInstruction (new MemoryBasedNasmAddress (REG_EBX, 0), new RegisterNasmAddress (REG_AL)));
-	ilist.push_back (new IncNasmInstruction (new RegisterNasmAddress (REG_EBX)));
-	ilist.push_back (new IncNasmInstruction (new RegisterNasmAddress (REG_ECX)));
-	ilist.push_back (new TestNasmInstruction (new RegisterNasmAddress (REG_AL), new RegisterNasmAddress (REG_AL)));
-	ilist.push_back (new JxxNasmInstruction ("_str_copy", "nz"));
-	ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_EAX), new ImmediateNasmAddress ((unsigned int) 0x0)));
-	ilist.push_back (new RetNasmInstruction ());
-
-
-	//
-	// String concatenation
-	//  EBX holds destination pointer
-	//  ECX holds str1 pointer
-	//  EDX holds str2 pointer
-	//  No return type
-	//
-	ilist.push_back (new LabelNasmInstruction ("_str_concat"));
-	ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_EAX), new ImmediateNasmAddress ((unsigned int) 0xFF00)));
-
-	ilist.push_back (new LabelNasmInstruction ("_str_concat_copy_s1"));
-	ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_AL), new MemoryBasedNasmAddress (REG_ECX, 0)));
-	ilist.push_back (new TestNasmInstruction (new RegisterNasmAddress (REG_AL), new RegisterNasmAddress (REG_AL)));
-	ilist.push_back (new JxxNasmInstruction ("_str_concat_copy_s2", "z"));
-	ilist.push_back (new TestNasmInstruction (new RegisterNasmAddress (REG_AH), new RegisterNasmAddress (REG_AH)));
-	ilist.push_back (new JxxNasmInstruction ("_str_concat_done", "z"));
-	ilist.push_back (new MovNasmInstruction (new MemoryBasedNasmAddress (REG_EBX, 0), new RegisterNasmAddress (REG_AL)));
-	ilist.push_back (new DecNasmInstruction (new RegisterNasmAddress (REG_AH)));
-	ilist.push_back (new IncNasmInstruction (new RegisterNasmAddress (REG_EBX)));
-	ilist.push_back (new IncNasmInstruction (new RegisterNasmAddress (REG_ECX)));
-	ilist.push_back (new JmpNasmInstruction ("_str_concat_copy_s1"));
-
-	ilist.push_back (new LabelNasmInstruction ("_str_concat_copy_s2"));
-	ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_AL), new MemoryBasedNasmAddress (REG_EDX, 0)));
-	ilist.push_back (new MovNasmInstruction (new MemoryBasedNasmAddress (REG_EBX, 0), new RegisterNasmAddress (REG_AL)));
-	ilist.push_back (new TestNasmInstruction (new RegisterNasmAddress (REG_AL), new RegisterNasmAddress (REG_AL)));
-	ilist.push_back (new JxxNasmInstruction ("_str_concat_done", "z"));
-	ilist.push_back (new TestNasmInstruction (new RegisterNasmAddress (REG_AH), new RegisterNasmAddress (REG_AH)));
-	ilist.push_back (new JxxNasmInstruction ("_str_concat_done", "z"));
-	ilist.push_back (new DecNasmInstruction (new RegisterNasmAddress (REG_AH)));
-	ilist.push_back (new IncNasmInstruction (new RegisterNasmAddress (REG_EBX)));
-	ilist.push_back (new IncNasmInstruction (new RegisterNasmAddress (REG_EDX)));
-	ilist.push_back (new JmpNasmInstruction ("_str_concat_copy_s2"));
-
-	ilist.push_back (new LabelNasmInstruction ("_str_concat_done"));
-	ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_EAX), new ImmediateNasmAddress ((unsigned int) 0x0)));
-	ilist.push_back (new MovNasmInstruction (new MemoryBasedNasmAddress (REG_EBX, 0), new RegisterNasmAddress (REG_AL)));
-	ilist.push_back (new RetNasmInstruction ());
+	InstructionListGuard exit_guard (program_exit_);
 
-
-	//
-	// String comparison
-	//  EBX holds str1 pointer
-	//  ECX holds str2 pointer
-	//  Return in EAX: 3 if str1 < str2; 2 if str1 == str2; 1 if str1 > str2
-	//
-	ilist.push_back (new LabelNasmInstruction ("_str_compare"));
-	ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_AL), new MemoryBasedNasmAddress (REG_EBX, 0)));
-	ilist.push_back (new CmpNasmInstruction (new RegisterNasmAddress (REG_AL), new MemoryBasedNasmAddress (REG_ECX, 0)));
-	ilist.push_back (new JxxNasmInstruction ("_str_compare_s2_larger", "l"));
-	ilist.push_back (new JxxNasmInstruction ("_str_compare_s1_larger", "g"));
-	ilist.push_back (new IncNasmInstruction (new RegisterNasmAddress (REG_EBX)));
-	ilist.push_back (new IncNasmInstruction (new RegisterNasmAddress (REG_ECX)));
-	ilist.push_back (new TestNasmInstruction (new RegisterNasmAddress (REG_AL), new RegisterNasmAddress (REG_AL)));
-	ilist.push_back (new JxxNasmInstruction ("_str_compare", "nz"));
-	ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_EAX), new ImmediateNasmAddress ((unsigned int) 0x2)));
-	ilist.push_back (new RetNasmInstruction ());
-
-	ilist.push_back (new LabelNasmInstruction ("_str_compare_s1_larger"));
-	ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_EAX), new ImmediateNasmAddress ((unsigned int) 0x1)));
-	ilist.push_back (new RetNasmInstruction ());
-	ilist.push_back (new LabelNasmInstruction ("_str_compare_s2_larger"));
-	ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_EAX), new ImmediateNasmAddress ((unsigned int) 0x3)));
-	ilist.push_back (new RetNasmInstruction ());
+	for (NasmBssMap::iterator it = bss_.begin (); it != bss_.end (); it ++)
+	{
+		delete (*it).second;
+	}
 }
 
 void X86NasmBackend::unrollMemoryBasedAddress (NasmAddress *address, NasmInstructionList &ilist, NasmAddress *dest)
@@ -129,6 +99,7 @@ void X86NasmBackend::unrollMemoryBasedAddress (NasmAddress *address, NasmInstruc
 		MemoryBasedNasmAddress *mb = (MemoryBasedNasmAddress *) address;
 		ilist.push_back (new MovNasmInstruction (dest, new RegisterNasmAddress (mb->getRegister ())));
 		ilist.push_back (new AddNasmInstruction (dest, new ImmediateNasmAddress (mb->getOffset ())));
+		NasmAddress::release (address);
 	}
 	else
 	{
@@ -175,16 +146,27 @@ int X86NasmBackend::compileAssignmentInstruction (AssignmentIlInstruction *instr
 			if (r_iladdr->getType () == BT_STRING)
 			{
 				AssignmentIlInstruction *as = (AssignmentIlInstruction *) instruction;
-				NasmAddress *dest = NasmAddress::fromIl (as->getResult (), data_, bss_, stack);
-				NasmAddress *src = NasmAddress::fromIl (as->getOperand1 (), data_, bss_, stack);
-				assert (dest != nullptr && src != nullptr);
+				NasmAddress *dest = r_addr;
+				NasmAddress *src = op1_addr;
 
 				// Unroll string addresses
 				unrollMemoryBasedAddress (dest, ilist, new RegisterNasmAddress (REG_EBX));
 				unrollMemoryBasedAddress (src, ilist, new RegisterNasmAddress (REG_ECX));
 
-				// Call
-				ilist.push_back (new CallNasmInstruction ("_str_copy"));
+				if (as->getResult ()->getAddressType () == ILA_TEMPORARY)
+				{
+					// Temporaries borrow the source descriptor, it outlives the statement
+					for (unsigned int i = 0; i < STRING_DESCRIPTOR_SIZE; i += 4)
+					{
+						ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_EAX), new MemoryBasedNasmAddress (REG_ECX, i)));
+						ilist.push_back (new MovNasmInstruction (new MemoryBasedNasmAddress (REG_EBX, i), new RegisterNasmAddress (REG_EAX)));
+					}
+				}
+				else
+				{
+					// Variables share or copy the characters
+					ilist.push_back (new CallNasmInstruction ("_str_copy"));
+				}
 
 				return NO_ERROR;
 			}
@@ -272,13 +254,10 @@ int X86NasmBackend::compileAssignmentInstruction (AssignmentIlInstruction *instr
 				return ER_FAILED;
 			}
 
-			NasmAddress *r_addr = NasmAddress::fromIl (r_iladdr, data_, bss_, stack);
-			NasmAddress *op_addr = NasmAddress::fromIl (op1_iladdr, data_, bss_, stack);
-
 			if (r_iladdr->getType () == BT_INT
 				&& op1_iladdr->getType() == BT_FLOAT)
 			{
-				ilist.push_back (new PushNasmInstruction (op_addr));
+				ilist.push_back (new PushNasmInstruction (op1_addr));
 				ilist.push_back (new FldNasmInstruction (new MemoryBasedNasmAddress (REG_ESP, 0)));
 				ilist.push_back (new FistpNasmInstruction (new MemoryBasedNasmAddress (REG_ESP, 0)));
 				ilist.push_back (new PopNasmInstruction (r_addr));
@@ -286,7 +265,7 @@ int X86NasmBackend::compileAssignmentInstruction (AssignmentIlInstruction *instr
 			else if (r_iladdr->getType () == BT_FLOAT
 					 && op1_iladdr->getType() == BT_INT)
 			{
-				ilist.push_back (new PushNasmInstruction (op_addr));
+				ilist.push_back (new PushNasmInstruction (op1_addr));
 				ilist.push_back (new FildNasmInstruction (new MemoryBasedNasmAddress (REG_ESP, 0)));
 				ilist.push_back (new FstpNasmInstruction (new MemoryBasedNasmAddress (REG_ESP, 0)));
 				ilist.push_back (new PopNasmInstruction (r_addr));
@@ -319,10 +298,13 @@ int X86NasmBackend::compileAssignmentInstruction (AssignmentIlInstruction *instr
 		case ILOP_ADD:
 			{
 				AssignmentIlInstruction *as = (AssignmentIlInstruction *) instruction;
-				NasmAddress *dest = NasmAddress::fromIl (as->getResult (), data_, bss_, stack);
-				NasmAddress *s1 = NasmAddress::fromIl (as->getOperand1 (), data_, bss_, stack);
-				NasmAddress *s2 = NasmAddress::fromIl (as->getOperand2 (), data_, bss_, stack);
-				assert (dest != nullptr && s1 != nullptr && s2 != nullptr);
+				NasmAddress *dest = r_addr;
+				NasmAddress *s1 = op1_addr;
+				NasmAddress *s2 = op2_addr;
+				assert (s2 != nullptr);
+
+				// Result lives in the string arena until the end of the statement
+				assert (as->getResult ()->getAddressType () == ILA_TEMPORARY);
 
 				// Unroll string addresses
 				unrollMemoryBasedAddress (dest, ilist, new RegisterNasmAddress (REG_EBX));
@@ -339,18 +321,24 @@ int X86NasmBackend::compileAssignmentInstruction (AssignmentIlInstruction *instr
 		case ILOP_EQ:
 		case ILOP_NE:
 			{
-				AssignmentIlInstruction *as = (AssignmentIlInstruction *) instruction;
-				NasmAddress *dest = NasmAddress::fromIl (as->getResult (), data_, bss_, stack);
-				NasmAddress *s1 = NasmAddress::fromIl (as->getOperand1 (), data_, bss_, stack);
-				NasmAddress *s2 = NasmAddress::fromIl (as->getOperand2 (), data_, bss_, stack);
-				assert (dest != nullptr && s1 != nullptr && s2 != nullptr);
+				NasmAddress *dest = r_addr;
+				NasmAddress *s1 = op1_addr;
+				NasmAddress *s2 = op2_addr;
+				assert (s2 != nullptr);
 
 				// Unroll string addresses
 				unrollMemoryBasedAddress (s1, ilist, new RegisterNasmAddress (REG_EBX));
 				unrollMemoryBasedAddress (s2, ilist, new RegisterNasmAddress (REG_ECX));
 
-				// Call comparison routine
-				ilist.push_back (new CallNasmInstruction ("_str_compare"));
+				// Call comparison routine (equality can bail out early on length)
+				if (op_type == ILOP_EQ || op_type == ILOP_NE)
+				{
+					ilist.push_back (new CallNasmInstruction ("_str_equal"));
+				}
+				else
+				{
+					ilist.push_back (new CallNasmInstruction ("_str_compare"));
+				}
 
 				// Put false in EBX and true in ECX
 				ilist.push_back (new MovNasmInstruction (new RegisterNasmAddress (REG_EBX), new ImmediateNasmAddress ((unsigned int) 0x0)));
@@ -844,7 +832,7 @@ int X86NasmBackend::compileAssignmentInstruction (AssignmentIlInstruction *instr
 			break;
 
 		case ILOP_MUL:
-			inst = new AddNasmInstruction (i_dest_addr, i_opr_addr);
+			inst = new ImulNasmInstruction (i_dest_addr, i_opr_addr);
 			break;
 
 		case ILOP_DIV:
@@ -1055,6 +1043,7 @@ int X86NasmBackend::compileAssignmentInstruction (AssignmentIlInstruction *instr
 					// CMOVNZ treg1, treg2    ; normalize treg1 to either 0 or 0xFFFFFFFF
 					ilist.push_back (new AndNasmInstruction (temp_reg1, i_opr_addr));
 					inst = new CmovxxNasmInstruction (temp_reg1, temp_reg2, "nz");
+					NasmAddress::release (temp_reg3);
 					break;
 
 				case ILOP_OR:
@@ -1062,6 +1051,7 @@ int X86NasmBackend::compileAssignmentInstruction (AssignmentIlInstruction *instr
 					// CMOVNZ treg1, treg2    ; normalize treg1 to either 0 or 0xFFFFFFFF
 					ilist.push_back (new OrNasmInstruction (temp_reg1, i_opr_addr));
 					inst = new CmovxxNasmInstruction (temp_reg1, temp_reg2, "nz");
+					NasmAddress::release (temp_reg3);
 					break;
 
 				case ILOP_XOR:
@@ -1069,13 +1059,22 @@ int X86NasmBackend::compileAssignmentInstruction (AssignmentIlInstruction *instr
 					// TEST   op2, 0xFFFFFFFF
 					// CMOVNZ treg3, treg2
 					// XOR    treg1, treg3    ; treg1 now holds result
-					ilist.push_back (new MovNasmInstruction (temp_reg3, new ImmediateNasmAddress ((unsigned int) 0x0)));
-					test = new TestNasmInstruction (
-								i_opr_addr,
-								new ImmediateNasmAddress ((unsigned int) 0xFFFFFFFF)
-							);
-					ilist.push_back (test);
-					ilist.push_back (new CmovxxNasmInstruction (temp_reg3, temp_reg2, "nz"));
+					if (i_opr_addr->getAddressType () == ADDR_IMMEDIATE)
+					{
+						// An immediate can't be tested, but its boolean value is known
+						unsigned int value = (((ImmediateNasmAddress *) i_opr_addr)->getData () != 0 ? 0xFFFFFFFF : 0x0);
+						ilist.push_back (new MovNasmInstruction (temp_reg3, new ImmediateNasmAddress (value)));
+					}
+					else
+					{
+						ilist.push_back (new MovNasmInstruction (temp_reg3, new ImmediateNasmAddress ((unsigned int) 0x0)));
+						test = new TestNasmInstruction (
+									i_opr_addr,
+									new ImmediateNasmAddress ((unsigned int) 0xFFFFFFFF)
+								);
+						ilist.push_back (test);
+						ilist.push_back (new CmovxxNasmInstruction (temp_reg3, temp_reg2, "nz"));
+					}
 					inst = new XorNasmInstruction (temp_reg1, temp_reg3);
 					break;
 				}
@@ -1118,8 +1117,8 @@ int X86NasmBackend::compileJumpInstruction (JumpIlInstruction *instruction, Nasm
 		if (addr->getAddressType () == ADDR_IMMEDIATE)
 		{
 			MovNasmInstruction *mov = new MovNasmInstruction (
-						addr,
-						new RegisterNasmAddress (REG_EAX)
+						new RegisterNasmAddress (REG_EAX),
+						addr
 					);
 			ilist.push_back (mov);
 			addr = new RegisterNasmAddress (REG_EAX);
@@ -1179,40 +1178,18 @@ int X86NasmBackend::compileInstruction (IlInstruction *instruction, NasmInstruct
 		ParamIlInstruction *pi = (ParamIlInstruction *) instruction;
 		NasmAddress *addr = NasmAddress::fromIl (pi->getParameter (), data_, bss_, stack);
 
-		if (pi->getParameter ()->getPushQword ())
+		// Push DWORD
+		PushNasmInstruction *push;
+		if (pi->getParameter ()->getType () == BT_STRING)
 		{
-			// FLOAT and PRINTF, fatal combination
-			// Copy 32bit float to 64bit double on stack
-			SubNasmInstruction *ssub = new SubNasmInstruction (
-						new RegisterNasmAddress (REG_ESP),
-						new ImmediateNasmAddress ((unsigned int) 8)
-					);
-			ilist.push_back (ssub);
-
-			FldNasmInstruction *fld = new FldNasmInstruction (addr);
-			ilist.push_back (fld);
-
-			FstpNasmInstruction *fstp = new FstpNasmInstruction (
-					new MemoryBasedNasmAddress (REG_ESP, 0)
-					);
-			fstp->setQword ();
-			ilist.push_back (fstp);
+			unrollMemoryBasedAddress (addr, ilist, new RegisterNasmAddress (REG_EAX));
+			push = new PushNasmInstruction (new RegisterNasmAddress (REG_EAX));
 		}
 		else
 		{
-			// Normal case, push DWORD
-			PushNasmInstruction *push;
-			if (pi->getParameter ()->getType () == BT_STRING)
-			{
-				unrollMemoryBasedAddress (addr, ilist, new RegisterNasmAddress (REG_EAX));
-				push = new PushNasmInstruction (new RegisterNasmAddress (REG_EAX));
-			}
-			else
-			{
-				push = new PushNasmInstruction (addr);
-			}
-			ilist.push_back (push);
+			push = new PushNasmInstruction (addr);
 		}
+		ilist.push_back (push);
 	}
 	else if (itype == ILI_CALL)
 	{
@@ -1223,11 +1200,14 @@ int X86NasmBackend::compileInstruction (IlInstruction *instruction, NasmInstruct
 		ilist.push_back (call);
 
 		// Pop parameters
-		AddNasmInstruction *add = new AddNasmInstruction (
-					new RegisterNasmAddress (REG_ESP),
-					new ImmediateNasmAddress ((unsigned int) ci->getParametersSize ())
-				);
-		ilist.push_back (add);
+		if (ci->getParametersSize () > 0)
+		{
+			AddNasmInstruction *add = new AddNasmInstruction (
+						new RegisterNasmAddress (REG_ESP),
+						new ImmediateNasmAddress ((unsigned int) ci->getParametersSize ())
+					);
+			ilist.push_back (add);
+		}
 	}
 	else
 	{
@@ -1262,10 +1242,24 @@ int X86NasmBackend::compileBlock (IlBlock *block, NasmInstructionList &ilist)
 	// We are building the following instructions at the beginning of the block:
 	//   PUSH EBP
 	//   MOV  EBP, ESP
-	//   SUB  ESP, stack_offset
+	//   SUB  EBP, stack_offset
+	//   AND  EBP, -STRING_ALIGNMENT
+	//   MOV  ESP, EBP
+	// Temporaries live at positive offsets from EBP, so the frame is placed below the
+	// stack pointer and aligned for the string routines
 	// We are inserting them in reverse order so they get executed in the correct order
-	ins = new SubNasmInstruction (
+	ins = new MovNasmInstruction (
 				new RegisterNasmAddress (REG_ESP),
+				new RegisterNasmAddress (REG_EBP)
+			);
+	ilist.push_front (ins);
+	ins = new AndNasmInstruction (
+				new RegisterNasmAddress (REG_EBP),
+				new ImmediateNasmAddress ((unsigned int) -STRING_ALIGNMENT)
+			);
+	ilist.push_front (ins);
+	ins = new SubNasmInstruction (
+				new RegisterNasmAddress (REG_EBP),
 				new ImmediateNasmAddress (NasmStackDefinition::getStackSize (stack))
 			);
 	ilist.push_front (ins);
@@ -1283,112 +1277,253 @@ int X86NasmBackend::compileBlock (IlBlock *block, NasmInstructionList &ilist)
 	return NO_ERROR;
 }
 
-void X86NasmBackend::printInstructionList (NasmInstructionList &ilist, std::ofstream &stream)
+int X86NasmBackend::runTool (std::string name, const std::vector<std::string> &args, const std::vector<int> &files)
+{
+	std::string command = args[0];
+	for (unsigned int i = 1; i < args.size (); i ++)
+	{
+		command += " " + args[i];
+	}
+	std::ostream &output = compilation_->getOutput ();
+	output << "[x86-nasm] running " << name << ": " << command << std::endl;
+
+	ToolUsage usage;
+	std::string messages;
+	int rc = ToolRunner::run (args, files, usage, messages);
+	compilation_->getDiagnostics () << messages;
+	if (rc != ER_FAILED)
+	{
+		compilation_->getTimeReport ()->addTool (name, usage);
+		output << "[x86-nasm] " << name << " finished in " << usage.wall_us / 1000 << " ms" << std::endl;
+	}
+
+	return rc;
+}
+
+void X86NasmBackend::collectExterns (NasmInstructionList &ilist, std::set<std::string> &externs)
+{
+	std::set<std::string> labels;
+	for (NasmInstruction *ins : ilist)
+	{
+		if (ins->getInstructionType () == NI_LABEL)
+		{
+			labels.insert (((LabelNasmInstruction *) ins)->getLabel ());
+		}
+	}
+
+	// Routines called but not defined here live in the runtime library
+	for (NasmInstruction *ins : ilist)
+	{
+		if (ins->getInstructionType () == NI_CALL && labels.count (((CallNasmInstruction *) ins)->getFunction ()) == 0)
+		{
+			externs.insert (((CallNasmInstruction *) ins)->getFunction ());
+		}
+	}
+}
+
+void X86NasmBackend::printInstructionList (NasmInstructionList &ilist, NasmWriter &stream)
 {
 	for (NasmInstructionList::iterator it = ilist.begin ();
 		 it != ilist.end (); it ++)
 	{
-		std::string text = ((*it)->getInstructionType () != NI_LABEL ? INDENT : "") + (*it)->toString ();
-		if ((*it)->getComment ().compare ("") != 0)
+		unsigned long line_start = stream.tell ();
+		if ((*it)->getInstructionType () != NI_LABEL)
 		{
-			if (text.length () < 40)
-			{
-				text += std::string (40 - text.length (), ' ');
-			}
+			stream << INDENT;
+		}
+		(*it)->write (stream);
 
+		if (!(*it)->getComment ().empty ())
+		{
 			// We have a comment, print it
-			text += " ; " + (*it)->getComment ();
+			stream.pad (line_start, 40);
+			stream << " ; " << (*it)->getComment ();
 		}
 
-		stream << text << std::endl;
+		stream << '\n';
 	}
 }
 
-int X86NasmBackend::compile (IlProgram *program, std::string output_file)
+int X86NasmBackend::compile (Compilation *compilation, IlProgram *program)
 {
-	// Generate internal functions
-	NasmInstructionList int_functions;
-	generateInternalFunctions (int_functions);
+	compilation_ = compilation;
+	const CompilationOptions &options = compilation->getOptions ();
+	const std::string &output_file = options.output_file;
+	std::ostream &output = compilation->getOutput ();
+
+	// Runtime library is linked in from its prebuilt archive
+	if (access (LIBCBASIC_ARCHIVE, R_OK) != 0)
+	{
+		Error::internalError ("[x86-nasm] runtime library '" LIBCBASIC_ARCHIVE "' not found, build the libcbasic target first");
+		return ER_FAILED;
+	}
+
+	// Code generation ends where the tools take over
+	int phase = compilation->getTimeReport ()->begin ("code generation");
 
 	// Compile program to Nasm primitives
 	NasmInstructionList main_block;
+	InstructionListGuard main_guard (main_block);
 	if (compileBlock (program->getMainBlock (), main_block) != NO_ERROR)
 	{
 		// Error should have been printed
 		return ER_FAILED;
 	}
 
-	// Determine assembly file
+	// Open assembly file, or an in-memory one if requested and supported
+	NasmWriter assembly;
 	std::string assembly_file = output_file + ".asm";
-	std::cout << "[x86-nasm] generating assembly file" << std::endl;
-
-	// Open assembly file
-	std::ofstream assembly;
-	assembly.open (assembly_file, std::ios::out);
+	if (options.assembly_in_memory && assembly.openMemory (assembly_file) == NO_ERROR)
+	{
+		assembly_file = ToolRunner::getFilePath (NASM_FILE_ASSEMBLY);
+		output << "[x86-nasm] generating assembly in memory" << '\n';
+	}
+	else
+	{
+		output << "[x86-nasm] generating assembly file" << '\n';
+		if (assembly.open (assembly_file) != NO_ERROR)
+		{
+			// Error should have been printed
+			return ER_FAILED;
+		}
+	}
 
-	// Write header
-	assembly << "bits 32" << std::endl;
-	assembly << "global " << ENTRY_POINT << std::endl;
-	assembly << "extern printf" << std::endl << std::endl;
+	// Write header, runtime library routines are resolved by the linker
+	assembly << "bits 32" << '\n';
+	assembly << "global " << ENTRY_POINT << '\n';
+	std::set<std::string> externs;
+	collectExterns (main_block, externs);
+	collectExterns (program_exit_, externs);
+	for (const std::string &name : externs)
+	{
+		assembly << "extern " << name << '\n';
+	}
+	assembly << '\n';
 
 	// Write symbols in data section
-	assembly << "section .data" << std::endl;
+	data_.shareCharacters ();
+	NasmIncbinFile incbin (output_file + ".data.bin");
+	if (options.assembly_in_memory)
+	{
+		incbin.openMemory (ToolRunner::getFilePath (NASM_FILE_INCBIN));
+	}
+	unsigned int data_offset = 0;
+	assembly << "section .data" << '\n';
 	for (NasmDataMap::iterator it = data_.begin (); it != data_.end (); it ++)
 	{
-		assembly << INDENT << (*it).second->toString () << std::endl;
+		// Descriptors are aligned, only pad after long strings
+		if (data_offset % STRING_ALIGNMENT != 0)
+		{
+			assembly << INDENT << "align " << STRING_ALIGNMENT << ", db 0" << '\n';
+			data_offset += STRING_ALIGNMENT - data_offset % STRING_ALIGNMENT;
+		}
+		assembly << INDENT << (*it)->toString (&incbin) << '\n';
+		data_offset += (*it)->getEmittedSize ();
+	}
+	if (!options.assembly_in_memory)
+	{
+		incbin.close ();
+	}
+	if (incbin.hasFailed ())
+	{
+		Error::internalError ("[x86-nasm] failed writing string data to '" + incbin.getFileName () + "'");
+		incbin.remove ();
+		return ER_FAILED;
+	}
+	assembly << '\n';
+
+	// VERBOSE code
+	if (compilation->isVerbose (VERBOSE_FLAG_PRINT_CONSTANT_POOL))
+	{
+		output << '\n' << "[VERBOSE] Constant pool: " << '\n';
+		data_.printStatistics (output);
+		output << "[VERBOSE END]" << '\n' << '\n';
 	}
-	assembly << std::endl;
 
 	// Write symbols in bss section
-	assembly << "section .bss" << std::endl;
+	assembly << "section .bss" << '\n';
 	for (NasmBssMap::iterator it = bss_.begin (); it != bss_.end (); it ++)
 	{
-		assembly << INDENT << (*it).second->toString () << std::endl;
+		if ((*it).second->getAlignment () > 1)
+		{
+			assembly << INDENT << "alignb " << (*it).second->getAlignment () << '\n';
+		}
+		assembly << INDENT << (*it).second->toString () << '\n';
 	}
-	assembly << std::endl;
+	assembly << '\n';
 
 	// Start .text section
-	assembly << "section .text" << std::endl << std::endl;
-
-	// Write internal subroutines
-	printInstructionList (int_functions, assembly);
-	assembly << std::endl;
+	assembly << "section .text" << '\n' << '\n';
 
 	// TODO: Write program subroutines
 
 	// Write main block
-	assembly << ENTRY_POINT << ":" << std::endl;
+	assembly << ENTRY_POINT << ":" << '\n';
 	printInstructionList (main_block, assembly);
 
 	// Write exit point
 	printInstructionList (program_exit_, assembly);
+	assembly << '\n';
 
-	// Close assembly
-	assembly.close ();
+	// Close assembly; an in-memory file stays open until the assembler has read it
+	if ((options.assembly_in_memory ? assembly.flush () : assembly.close ()) != NO_ERROR)
+	{
+		Error::internalError ("[x86-nasm] failed writing assembly to '" + assembly_file + "'");
+		return ER_FAILED;
+	}
+	compilation->getTimeReport ()->end (phase);
 
-	// Determine object file
+	// Determine object file, kept in memory along with the assembly
 	std::string object_file = output_file + ".o";
-	std::string list_file = output_file + ".lst";
+	int object_fd = (options.assembly_in_memory ? ToolRunner::createMemoryFile (object_file) : ER_FAILED);
+	DescriptorGuard object_guard (object_fd);
 
 	// Call NASM
-	std::string nasm_command =
-		"nasm -g -f elf32 -l " + list_file + " -o " + object_file + " " + assembly_file;
-	std::cout << "[x86-nasm] running assembler: " << nasm_command << std::endl;
-	int nasm_rc = system (nasm_command.c_str ());
+	std::vector<std::string> nasm_args = { "nasm", "-g", "-f", "elf32" };
+	if (options.listing)
+	{
+		nasm_args.insert (nasm_args.end (), { "-l", output_file + ".lst" });
+	}
+	nasm_args.insert (nasm_args.end (), { "-o", object_fd >= 0 ? ToolRunner::getFilePath (NASM_FILE_OBJECT) : object_file, assembly_file });
+	std::vector<int> nasm_files (NASM_FILE_COUNT, -1);
+	nasm_files[NASM_FILE_ASSEMBLY] = assembly.getDescriptor ();
+	nasm_files[NASM_FILE_OBJECT] = object_fd;
+	nasm_files[NASM_FILE_INCBIN] = incbin.getDescriptor ();
+	int nasm_rc = runTool ("assembler", nasm_args, nasm_files);
+
+	// Long string data is only needed by the assembler, unless a listing refers to it
+	if (!options.listing)
+	{
+		incbin.remove ();
+	}
 	if (nasm_rc != NO_ERROR)
 	{
-		Error::internalError ("[x86-nasm] nasm exited with error code "	+ std::to_string (nasm_rc));
+		if (nasm_rc != ER_FAILED)
+		{
+			Error::internalError ("[x86-nasm] nasm exited with error code " + std::to_string (nasm_rc));
+		}
 		return ER_FAILED;
 	}
 
 	// Call linker
-	std::string ld_command =
-		"ld -m elf_i386 -lc -dynamic-linker /usr/lib32/ld-linux.so.2 -L/usr/lib32 -e " ENTRY_POINT " -o " + output_file + " " + object_file;
-	std::cout << "[x86-nasm] running linker: " << ld_command << std::endl;
-	int ld_rc = system (ld_command.c_str ());
+	std::vector<std::string> ld_args = { "ld", "-m", "elf_i386" };
+	if (options.static_linking)
+	{
+		// The runtime library only uses system calls, nothing else is needed
+		ld_args.insert (ld_args.end (), { "-static" });
+	}
+	else
+	{
+		ld_args.insert (ld_args.end (), { "-lc", "-dynamic-linker", "/usr/lib32/ld-linux.so.2", "-L/usr/lib32" });
+	}
+	ld_args.insert (ld_args.end (), { "-e", ENTRY_POINT, "-o", output_file, object_fd >= 0 ? ToolRunner::getFilePath (0) : object_file, LIBCBASIC_ARCHIVE });
+	int ld_rc = runTool ("linker", ld_args, std::vector<int> (1, object_fd));
 	if (ld_rc != NO_ERROR)
 	{
-		Error::internalError ("[x86-nasm] ld exited with error code " + std::to_string (ld_rc));
+		if (ld_rc != ER_FAILED)
+		{
+			Error::internalError ("[x86-nasm] ld exited with error code " + std::to_string (ld_rc));
+		}
 		return ER_FAILED;
 	}
 
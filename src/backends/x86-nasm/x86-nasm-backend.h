@@ -1,6 +1,8 @@
 #ifndef X86_NASM_BACKEND_H_
 #define X86_NASM_BACKEND_H_
 
+#include <vector>
+#include <set>
 #include "backends/interface/backend.h"
 #include "ilang/il-block.h"
 #include "ilang/il-program.h"
@@ -19,19 +21,24 @@ private:
 
 	NasmInstructionList program_exit_;
 
-	void generateInternalFunctions (NasmInstructionList &ilist);
+	// Compilation being compiled
+	Compilation *compilation_;
+
 	void unrollMemoryBasedAddress (NasmAddress *address, NasmInstructionList &ilist, NasmAddress *dest);
 
 	int compileAssignmentInstruction (AssignmentIlInstruction *instruction, NasmInstructionList &ilist, NasmStackMap &stack);
 	int compileJumpInstruction (JumpIlInstruction *instruction, NasmInstructionList &ilist, NasmStackMap &stack);
 	int compileInstruction (IlInstruction *instruction, NasmInstructionList &ilist, NasmStackMap &stack);
 	int compileBlock (IlBlock *block, NasmInstructionList &ilist);
-	void printInstructionList (NasmInstructionList &ilist, std::ofstream &stream);
+	void collectExterns (NasmInstructionList &ilist, std::set<std::string> &externs);
+	void printInstructionList (NasmInstructionList &ilist, NasmWriter &stream);
+	int runTool (std::string name, const std::vector<std::string> &args, const std::vector<int> &files);
 
 public:
 	X86NasmBackend ();
+	~X86NasmBackend ();
 
-	int compile (IlProgram *program, std::string output_file);
+	int compile (Compilation *compilation, IlProgram *program);
 };
 
 #endif
@@ -1,9 +1,14 @@
 #include "x86-nasm-primitives.h"
-#include <sstream>
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
 #include "error/error.h"
+#include "backends/interface/tool-runner.h"
 
 NasmDataDefinition::NasmDataDefinition (std::string label, int size, char *data)
 {
@@ -11,30 +16,303 @@ NasmDataDefinition::NasmDataDefinition (std::string label, int size, char *data)
 	memcpy (data_, data, size);
 	size_ = size;
 	label_ = label;
+	out_of_line_ = false;
+	owner_ = nullptr;
+	owner_offset_ = 0;
 }
 
 NasmDataDefinition::NasmDataDefinition (std::string label, std::string str)
 {
-	int slen = str.length ();
-	size_ = 1 + (slen > 255 ? 255 : slen);
-	data_ = (char *) malloc (size_);
-	memcpy (data_, str.c_str (), size_ - 1);
-	data_[size_ - 1] = 0; // Terminator
+	unsigned int slen = str.length ();
+	out_of_line_ = (slen > STRING_INLINE_MAX);
+
+	// Descriptor, with long strings placed right after it
+	size_ = STRING_DESCRIPTOR_SIZE + (out_of_line_ ? slen : 0);
+	data_ = (char *) calloc (size_, 1);
+	for (int i = 0; i < STRING_INLINE; i ++)
+	{
+		data_[i] = (char) (slen >> (8 * i)); // Little endian length
+	}
+	memcpy (data_ + (out_of_line_ ? STRING_DESCRIPTOR_SIZE : STRING_INLINE), str.c_str (), slen);
 
 	label_ = label;
+	owner_ = nullptr;
+	owner_offset_ = 0;
+}
+
+//
+// Quote bytes as a NASM backquoted string, escaping anything that is not printable
+//
+static std::string quote_bytes (const char *data, unsigned int size)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	std::string quoted = "`";
+	quoted.reserve (size + 2);
+	for (unsigned int i = 0; i < size; i ++)
+	{
+		unsigned char c = (unsigned char) data[i];
+		if (c == '`' || c == '\\')
+		{
+			quoted += '\\';
+			quoted += (char) c;
+		}
+		else if (c >= 0x20 && c < 0x7f)
+		{
+			quoted += (char) c;
+		}
+		else if (c == '\n')
+		{
+			quoted += "\\n";
+		}
+		else if (c == '\t')
+		{
+			quoted += "\\t";
+		}
+		else
+		{
+			quoted += "\\x";
+			quoted += hex[c >> 4];
+			quoted += hex[c & 0xf];
+		}
+	}
+	quoted += '`';
+
+	return quoted;
+}
+
+//
+// Little endian dword at the given position
+//
+static unsigned int read_dword (const char *data)
+{
+	unsigned int value = 0;
+	for (int i = 0; i < 4; i ++)
+	{
+		value |= ((unsigned int) (unsigned char) data[i]) << (8 * i);
+	}
+	return value;
+}
+
+int NasmIncbinFile::openMemory (std::string path)
+{
+	fd_ = ToolRunner::createMemoryFile (file_name_);
+	if (fd_ < 0)
+	{
+		return ER_FAILED;
+	}
+
+	file_name_ = path;
+	in_memory_ = true;
+	return NO_ERROR;
+}
+
+unsigned int NasmIncbinFile::append (const char *data, unsigned int size)
+{
+	if (fd_ < 0 && !in_memory_)
+	{
+		fd_ = ::open (file_name_.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		failed_ = (fd_ < 0);
+	}
+
+	unsigned int offset = size_, written = 0;
+	while (!failed_ && written < size)
+	{
+		ssize_t rc = ::write (fd_, data + written, size - written);
+		if (rc < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (rc <= 0)
+		{
+			failed_ = true;
+			break;
+		}
+		written += rc;
+	}
+	size_ += written;
+
+	return offset;
 }
 
-std::string NasmDataDefinition::toString ()
+void NasmIncbinFile::close ()
 {
-	std::stringstream hx;
-	hx << std::hex;
+	if (fd_ >= 0)
+	{
+		::close (fd_);
+		fd_ = -1;
+	}
+}
 
-	for (int i = 0; i < size_; i ++)
+void NasmIncbinFile::remove ()
+{
+	if (!in_memory_ && (size_ > 0 || failed_))
 	{
-		hx << "0x" << (unsigned int) data_[i] << (i < size_-1 ? "," : "");
+		close ();
+		unlink (file_name_.c_str ());
 	}
+}
 
-	return label_ + " db " + hx.str();
+NasmDataDefinition::~NasmDataDefinition ()
+{
+	free (data_);
+}
+
+std::string NasmDataDefinition::toString (NasmIncbinFile *incbin)
+{
+	unsigned int slen = read_dword (data_);
+
+	if (owner_ != nullptr)
+	{
+		// Descriptor points into the characters of another string
+		return label_ + " dd " + std::to_string (slen) + ", " + owner_->getLabel () + " + "
+			+ std::to_string (STRING_DESCRIPTOR_SIZE + owner_offset_) + ", 0, 0";
+	}
+	else if (out_of_line_)
+	{
+		// Descriptor points to the characters following it
+		std::string def = label_ + " dd " + std::to_string (slen) + ", " + label_ + " + "
+			+ std::to_string (STRING_DESCRIPTOR_SIZE) + ", 0, 0\n" + INDENT;
+		if (incbin != nullptr && slen >= DATA_INCBIN_THRESHOLD)
+		{
+			unsigned int offset = incbin->append (data_ + STRING_DESCRIPTOR_SIZE, slen);
+			return def + "incbin \"" + incbin->getFileName () + "\", " + std::to_string (offset) + ", " + std::to_string (slen);
+		}
+		return def + "db " + quote_bytes (data_ + STRING_DESCRIPTOR_SIZE, slen);
+	}
+	else if (size_ == STRING_DESCRIPTOR_SIZE)
+	{
+		// Inline characters, padded to the descriptor size
+		std::string def = label_ + " dd " + std::to_string (slen);
+		if (slen > 0)
+		{
+			def += std::string ("\n") + INDENT + "db " + quote_bytes (data_ + STRING_INLINE, slen);
+		}
+		if (slen < STRING_INLINE_MAX)
+		{
+			def += std::string ("\n") + INDENT + "times " + std::to_string (STRING_INLINE_MAX - slen) + " db 0";
+		}
+		return def;
+	}
+
+	// Raw data, as dwords where possible
+	std::string def = label_;
+	unsigned int i = 0;
+	if (size_ >= 4)
+	{
+		def += " dd ";
+		for (; i + 4 <= size_; i += 4)
+		{
+			def += std::to_string (read_dword (data_ + i)) + (i + 8 <= size_ ? ", " : "");
+		}
+	}
+	if (i < size_)
+	{
+		def += (i > 0 ? std::string ("\n") + INDENT + "db " : std::string (" db ")) + quote_bytes (data_ + i, size_ - i);
+	}
+	return def;
+}
+
+std::string NasmDataDefinition::getCharacters () const
+{
+	assert (out_of_line_);
+	return std::string (data_ + STRING_DESCRIPTOR_SIZE, size_ - STRING_DESCRIPTOR_SIZE);
+}
+
+void NasmDataDefinition::setOwner (NasmDataDefinition *owner, unsigned int offset)
+{
+	assert (out_of_line_ && owner->out_of_line_);
+	owner_ = owner;
+	owner_offset_ = offset;
+}
+
+NasmDataMap::~NasmDataMap ()
+{
+	// The map refers to the same definitions
+	for (NasmDataDefinition *def : definitions_)
+	{
+		delete def;
+	}
+}
+
+NasmDataDefinition *NasmDataMap::getString (ConstantIlAddress *address)
+{
+	std::string str = address->getString ();
+	bool new_address = addresses_.insert (address).second;
+
+	NasmConstantKey key = { BT_STRING, str };
+	auto fret = map_.find (key);
+	if (fret != map_.end ())
+	{
+		if (new_address)
+		{
+			reused_bytes_ += (*fret).second->getSize ();
+		}
+		return (*fret).second;
+	}
+
+	std::string label = "str_" + std::to_string (definitions_.size ());
+	NasmDataDefinition *ddef = new NasmDataDefinition (label, str);
+	map_.insert ( { key, ddef } );
+	definitions_.push_back (ddef);
+	return ddef;
+}
+
+void NasmDataMap::shareCharacters ()
+{
+	// Longest strings first, they are the candidate owners
+	std::vector<NasmDataDefinition *> strings;
+	for (NasmDataDefinition *def : definitions_)
+	{
+		if (def->isOutOfLine () && !def->isShared ())
+		{
+			strings.push_back (def);
+		}
+	}
+	std::stable_sort (strings.begin (), strings.end (),
+		[] (NasmDataDefinition *a, NasmDataDefinition *b)
+		{
+			return a->getSize () > b->getSize ();
+		});
+
+	std::vector<std::string> owners;
+	std::vector<NasmDataDefinition *> owner_defs;
+	for (NasmDataDefinition *def : strings)
+	{
+		std::string chars = def->getCharacters ();
+		bool shared = false;
+		for (unsigned int i = 0; i < owners.size () && !shared; i ++)
+		{
+			size_t pos = owners[i].find (chars);
+			if (pos != std::string::npos)
+			{
+				def->setOwner (owner_defs[i], pos);
+				shared_bytes_ += chars.length ();
+				shared = true;
+			}
+		}
+
+		if (!shared)
+		{
+			owners.push_back (chars);
+			owner_defs.push_back (def);
+		}
+	}
+}
+
+void NasmDataMap::printStatistics (std::ostream &stream)
+{
+	unsigned int size = 0;
+	for (NasmDataDefinition *def : definitions_)
+	{
+		size += def->getEmittedSize ();
+	}
+
+	stream << INDENT << "constant references: " << addresses_.size () << std::endl;
+	stream << INDENT << "distinct constants:  " << definitions_.size () << std::endl;
+	stream << INDENT << "definition bytes:    " << size << std::endl;
+	stream << INDENT << "bytes deduplicated:  " << reused_bytes_ << std::endl;
+	stream << INDENT << "characters shared:   " << shared_bytes_ << std::endl;
 }
 
 unsigned int NasmStackDefinition::getStackSize (NasmStackMap &map)
@@ -50,6 +328,23 @@ unsigned int NasmStackDefinition::getStackSize (NasmStackMap &map)
 	return max_size;
 }
 
+NasmAddress *NasmAddress::acquire (NasmAddress *address)
+{
+	if (address != nullptr)
+	{
+		address->references_ ++;
+	}
+	return address;
+}
+
+void NasmAddress::release (NasmAddress *address)
+{
+	if (address != nullptr && (address->references_ == 0 || -- address->references_ == 0))
+	{
+		delete address;
+	}
+}
+
 NasmAddress *NasmAddress::fromIl (IlAddress *iladdr, NasmDataMap &data, NasmBssMap &bss, NasmStackMap &stack)
 {
 	IlAddressType atype = iladdr->getAddressType ();
@@ -84,7 +379,7 @@ NasmAddress *NasmAddress::fromIl (IlAddress *iladdr, NasmDataMap &data, NasmBssM
 		}
 		else if (va->getType () == BT_STRING)
 		{
-			bd = new NasmBssDefinition (va->getSymbol ()->getName (), 256);
+			bd = new NasmBssDefinition (va->getSymbol ()->getName (), STRING_DESCRIPTOR_SIZE, STRING_ALIGNMENT);
 			bss.insert ( { name, bd } );
 			return new ImmediatePtrNasmAddress (name);
 		}
@@ -107,20 +402,7 @@ NasmAddress *NasmAddress::fromIl (IlAddress *iladdr, NasmDataMap &data, NasmBssM
 		}
 		else if (ca->getType() == BT_STRING)
 		{
-			NasmDataDefinition *ddef = nullptr;
-			NasmDataMap::iterator fret = data.find (ca);
-
-			if (fret != data.end ())
-			{
-				ddef = (*fret).second;
-			}
-			else
-			{
-				std::string label = "str_" + std::to_string ((unsigned long int) iladdr);
-				ddef = new NasmDataDefinition (label, ca->getString ());
-				data.insert ( { ca, ddef } );
-			}
-
+			NasmDataDefinition *ddef = data.getString (ca);
 			naddr = new ImmediatePtrNasmAddress (ddef->getLabel ());
 		}
 		else
@@ -154,8 +436,8 @@ NasmAddress *NasmAddress::fromIl (IlAddress *iladdr, NasmDataMap &data, NasmBssM
 			}
 			else if (ta->getType () == BT_STRING)
 			{
-				offset = ssize + 256;
-				stack.emplace (ta->getName (), NasmStackDefinition (256, offset));
+				offset = (ssize + STRING_DESCRIPTOR_SIZE + STRING_ALIGNMENT - 1) & ~(STRING_ALIGNMENT - 1);
+				stack.emplace (ta->getName (), NasmStackDefinition (STRING_DESCRIPTOR_SIZE, offset));
 				naddr = new MemoryBasedNasmAddress (REG_EBP, offset);
 			}
 			else
@@ -186,11 +468,3 @@ ImmediateNasmAddress::ImmediateNasmAddress (int data)
 	unsigned int *addr = (unsigned int *)&data;
 	data_ = *addr;
 }
-
-std::string ImmediateNasmAddress::toString ()
-{
-	std::stringstream hx;
-	hx << std::hex << data_;
-
-	return "dword 0x" + hx.str ();
-}
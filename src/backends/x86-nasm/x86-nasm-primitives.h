@@ -2,9 +2,74 @@
 #define X86_NASM_PRIMITIVES_H_
 
 #include "ilang/il-address.h"
+#include "x86-nasm-writer.h"
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <list>
+#include <ostream>
+#include <fstream>
+
+//
+// Printing aliases
+//
+#define INDENT			"  "
+
+//
+// Strings are 16 byte descriptors: a dword length followed by the characters, if
+// there are at most STRING_INLINE_MAX of them, or by a pointer to the characters and
+// a dword telling where they live (0 for literals, see the runtime library)
+//
+#define STRING_DESCRIPTOR_SIZE	16
+#define STRING_INLINE			4
+#define STRING_INLINE_MAX		(STRING_DESCRIPTOR_SIZE - STRING_INLINE)
+#define STRING_ALIGNMENT		16
+
+//
+// Characters of string literals at least this long are written to a binary file and
+// pulled in with incbin instead of being spelled out in the assembly
+//
+#define DATA_INCBIN_THRESHOLD	4096
+
+//
+// Binary file for incbin'd data
+// Written to disk next to the output, or kept in an anonymous in-memory file along
+// with the assembly
+//
+class NasmIncbinFile
+{
+private:
+	std::string file_name_;
+	int fd_;
+	unsigned int size_;
+	bool in_memory_;
+	// The file could not be opened or a write to it failed
+	bool failed_;
+
+public:
+	NasmIncbinFile (std::string file_name) : file_name_ (file_name), fd_ (-1), size_ (0), in_memory_ (false), failed_ (false) { }
+	~NasmIncbinFile () { close (); }
+
+	// Keep the data in memory; path is where the assembler opens the file
+	int openMemory (std::string path);
+
+	// Append data to the file, returns the offset it was written at; failures are
+	// recorded, see hasFailed
+	unsigned int append (const char *data, unsigned int size);
+
+	// Close the file, if it was ever opened
+	void close ();
+
+	// Remove the file from disk, if it was written there
+	void remove ();
+
+	// Getters
+	std::string getFileName () const { return file_name_; }
+	int getDescriptor () const { return fd_; }
+	unsigned int getSize () const { return size_; }
+	bool hasFailed () const { return failed_; }
+};
 
 //
 // Data section definition
@@ -15,6 +80,11 @@ private:
 	std::string label_;
 	unsigned int size_;
 	char *data_;
+	// String characters follow the descriptor instead of being inline
+	bool out_of_line_;
+	// String characters are found in another definition
+	NasmDataDefinition *owner_;
+	unsigned int owner_offset_;
 
 	// Hidden constructor
 	NasmDataDefinition () { }
@@ -22,15 +92,81 @@ private:
 public:
 	NasmDataDefinition (std::string label, int size, char *data);
 	NasmDataDefinition (std::string label, std::string str);
+	~NasmDataDefinition ();
 
-	// Compilable string
-	std::string toString ();
+	// Compilable string; large string characters go to the incbin file, if one is given
+	std::string toString (NasmIncbinFile *incbin = nullptr);
 
-	// Get the label
+	// Getters
 	std::string getLabel () const { return label_; }
+	unsigned int getSize () const { return size_; }
+	unsigned int getEmittedSize () const { return (owner_ != nullptr ? STRING_DESCRIPTOR_SIZE : size_); }
+	bool isOutOfLine () const { return out_of_line_; }
+	bool isShared () const { return owner_ != nullptr; }
+
+	// Get the characters of an out of line string
+	std::string getCharacters () const;
+
+	// Point to the characters of another definition instead of having a copy
+	void setOwner (NasmDataDefinition *owner, unsigned int offset);
+};
+
+//
+// Constant pool
+// Constants are keyed by type and value, so equal constants get a single definition
+// no matter how many IL addresses refer to them
+//
+struct NasmConstantKey
+{
+	BasicType type_;
+	std::string value_;
+
+	bool operator== (const NasmConstantKey &other) const
+	{
+		return type_ == other.type_ && value_ == other.value_;
+	}
+};
+
+struct NasmConstantKeyHash
+{
+	size_t operator() (const NasmConstantKey &key) const
+	{
+		return std::hash<std::string> () (key.value_) * 31 + (size_t) key.type_;
+	}
 };
 
-typedef std::unordered_map<ConstantIlAddress *, NasmDataDefinition *> NasmDataMap;
+class NasmDataMap
+{
+private:
+	std::unordered_map<NasmConstantKey, NasmDataDefinition *, NasmConstantKeyHash> map_;
+	// Definitions in order of creation, so output does not depend on hashing
+	std::vector<NasmDataDefinition *> definitions_;
+
+	// Statistics
+	std::unordered_set<ConstantIlAddress *> addresses_;
+	unsigned int reused_bytes_;
+	unsigned int shared_bytes_;
+
+public:
+	typedef std::vector<NasmDataDefinition *>::iterator iterator;
+
+	NasmDataMap () : reused_bytes_ (0), shared_bytes_ (0) { }
+	~NasmDataMap ();
+
+	// Get the definition of a string constant, creating it on first use
+	NasmDataDefinition *getString (ConstantIlAddress *address);
+
+	// Long string literals found inside other ones point to their characters instead
+	// of having their own copy
+	void shareCharacters ();
+
+	// Iterate definitions
+	iterator begin () { return definitions_.begin (); }
+	iterator end () { return definitions_.end (); }
+
+	// Print pool statistics
+	void printStatistics (std::ostream &stream);
+};
 
 //
 // Bss section definition
@@ -40,16 +176,21 @@ class NasmBssDefinition
 private:
 	std::string label_;
 	unsigned int size_;
+	unsigned int align_;
 	// Hidden constructor
 	NasmBssDefinition ();
 public:
-	NasmBssDefinition (std::string label, unsigned int size) : label_ (label), size_ (size) { }
+	NasmBssDefinition (std::string label, unsigned int size, unsigned int align = 1)
+		: label_ (label), size_ (size), align_ (align) { }
 
 	// Compilable string
 	std::string toString () const { return label_ + ": resb " + std::to_string (size_); }
 
 	// Get the label
 	std::string getLabel () const { return label_; }
+
+	// Get the alignment
+	unsigned int getAlignment () const { return align_; }
 };
 
 typedef std::unordered_map<std::string, NasmBssDefinition *> NasmBssMap;
@@ -80,10 +221,13 @@ enum NasmRegister
 	REG_AL,
 	REG_AH,
 	REG_AX,
+	REG_CL,
 	REG_EAX,
 	REG_EBX,
 	REG_ECX,
 	REG_EDX,
+	REG_ESI,
+	REG_EDI,
 
 	REG_ESP,
 	REG_EBP,
@@ -92,7 +236,7 @@ enum NasmRegister
 	REG_ST1
 };
 
-static std::string NasmRegisterAlias[] = { "al", "ah", "ax", "eax", "ebx", "ecx", "edx", "esp", "ebp", "st0", "st1" };
+static std::string NasmRegisterAlias[] = { "al", "ah", "ax", "cl", "eax", "ebx", "ecx", "edx", "esi", "edi", "esp", "ebp", "st0", "st1" };
 
 //
 // Data locations
@@ -106,16 +250,29 @@ enum NasmAddressType
 	ADDR_MEMORY_BASED
 };
 
+//
+// Instructions often share an address, so each one takes a reference to the addresses
+// it uses and the last one to be deleted deletes the address
+//
 class NasmAddress
 {
+private:
+	unsigned int references_;
 protected:
 	// Hidden constructor
-	NasmAddress () { }
+	NasmAddress () : references_ (0) { }
 public:
 	virtual ~NasmAddress () { }
 
-	// Compilable string representation
-	virtual std::string toString () = 0;
+	// Take a reference to an address
+	static NasmAddress *acquire (NasmAddress *address);
+
+	// Drop a reference to an address, deleting it if it was the last one; an address
+	// no instruction took a reference to is deleted right away
+	static void release (NasmAddress *address);
+
+	// Write compilable representation
+	virtual void write (NasmWriter &out) = 0;
 
 	// Type
 	virtual NasmAddressType getAddressType () const = 0;
@@ -127,6 +284,12 @@ public:
 	static NasmAddress *fromIl (IlAddress *iladdr, NasmDataMap &data, NasmBssMap &bss, NasmStackMap &stack);
 };
 
+inline NasmWriter &operator<< (NasmWriter &out, NasmAddress *address)
+{
+	address->write (out);
+	return out;
+}
+
 class ImmediateNasmAddress : public NasmAddress
 {
 private:
@@ -139,7 +302,7 @@ public:
 	ImmediateNasmAddress (int data);
 	ImmediateNasmAddress (float data);
 
-	std::string toString ();
+	void write (NasmWriter &out) { out << "dword 0x"; out.writeHex (data_); }
 	NasmAddressType getAddressType () const { return ADDR_IMMEDIATE; }
 	bool isMemory () const { return false; }
 
@@ -156,7 +319,7 @@ private:
 public:
 	ImmediatePtrNasmAddress (std::string label) : label_ (label) { };
 
-	std::string toString () { return label_; };
+	void write (NasmWriter &out) { out << label_; }
 	NasmAddressType getAddressType () const { return ADDR_IMMEDIATE_PTR; }
 	bool isMemory () const { return false; }
 };
@@ -170,7 +333,7 @@ private:
 public:
 	RegisterNasmAddress (NasmRegister reg) : reg_ (reg) { }
 
-	std::string toString () { return NasmRegisterAlias[reg_]; }
+	void write (NasmWriter &out) { out << NasmRegisterAlias[reg_]; }
 	NasmAddressType getAddressType () const { return ADDR_REGISTER; }
 	bool isMemory () const { return false; }
 
@@ -187,7 +350,7 @@ private:
 public:
 	MemoryDirectNasmAddress (std::string label) : label_ (label) { };
 
-	std::string toString () { return "[" + label_ + "]"; }
+	void write (NasmWriter &out) { out << "[" << label_ << "]"; }
 	NasmAddressType getAddressType () const { return ADDR_MEMORY_DIRECT; }
 	bool isMemory () const { return true; }
 };
@@ -204,7 +367,7 @@ private:
 public:
 	MemoryBasedNasmAddress (NasmRegister reg, unsigned int offset) : reg_ (reg), offset_ (offset) { }
 
-	std::string toString () { return "[" + NasmRegisterAlias[reg_] + (offset_ >= 0 ? "+" : "") + std::to_string (offset_) + "]"; }
+	void write (NasmWriter &out) { out << "[" << NasmRegisterAlias[reg_] << (offset_ >= 0 ? "+" : "") << offset_ << "]"; }
 	NasmAddressType getAddressType () const { return ADDR_MEMORY_BASED; }
 	bool isMemory () const { return true; }
 
@@ -223,11 +386,14 @@ enum NasmInstructionType
 	NI_INC,
 	NI_DEC,
 	NI_MOV,
+	NI_MOVSB,
 
 	NI_ADD,
 	NI_SUB,
 	NI_IMUL,
 	NI_IDIV,
+	NI_DIV,
+	NI_NEG,
 
 	NI_AND,
 	NI_OR,
@@ -275,10 +441,11 @@ protected:
 public:
 	virtual ~NasmInstruction () { };
 
-	virtual std::string toString () = 0;
+	// Write compilable representation
+	virtual void write (NasmWriter &out) = 0;
 	virtual NasmInstructionType getInstructionType () const = 0;
 
-	std::string getComment () const { return comment_; }
+	const std::string &getComment () const { return comment_; }
 	void setComment (std::string comm) { comment_ = comm; }
 };
 
@@ -292,7 +459,9 @@ protected:
 public:
 	LabelNasmInstruction (std::string label) : label_ (label) { }
 
-	std::string toString () { return label_ + ":"; }
+	const std::string &getLabel () const { return label_; }
+
+	void write (NasmWriter &out) { out << label_ << ":"; }
 	NasmInstructionType getInstructionType () const { return NI_LABEL; }
 };
 
@@ -308,7 +477,7 @@ private:
 public:
 	IntNasmInstruction (unsigned int interrupt) : interrupt_ (interrupt) { }
 
-	std::string toString () { return "int   " + std::to_string (interrupt_); }
+	void write (NasmWriter &out) { out << "int   " << interrupt_; }
 	NasmInstructionType getInstructionType () const { return NI_INT; }
 };
 
@@ -319,10 +488,10 @@ private:
 	// Hidden constructor
 	IncNasmInstruction () { };
 public:
-	IncNasmInstruction (NasmAddress *op) : op_ (op) { };
-	~IncNasmInstruction () { delete op_; }
+	IncNasmInstruction (NasmAddress *op) : op_ (NasmAddress::acquire (op)) { };
+	~IncNasmInstruction () { NasmAddress::release (op_); }
 
-	std::string toString () { return "inc   " + op_->toString (); }
+	void write (NasmWriter &out) { out << "inc   " << op_; }
 	NasmInstructionType getInstructionType () const { return NI_INC; }
 };
 
@@ -333,10 +502,10 @@ private:
 	// Hidden constructor
 	DecNasmInstruction () { };
 public:
-	DecNasmInstruction (NasmAddress *op) : op_ (op) { };
-	~DecNasmInstruction () { delete op_; }
+	DecNasmInstruction (NasmAddress *op) : op_ (NasmAddress::acquire (op)) { };
+	~DecNasmInstruction () { NasmAddress::release (op_); }
 
-	std::string toString () { return "dec   " + op_->toString (); }
+	void write (NasmWriter &out) { out << "dec   " << op_; }
 	NasmInstructionType getInstructionType () const { return NI_DEC; }
 };
 
@@ -348,10 +517,10 @@ private:
 	// Hidden constructor
 	MovNasmInstruction () { };
 public:
-	MovNasmInstruction (NasmAddress *dest, NasmAddress *src) : dest_ (dest), src_ (src) { };
-	~MovNasmInstruction () { delete dest_; delete src_; }
+	MovNasmInstruction (NasmAddress *dest, NasmAddress *src) : dest_ (NasmAddress::acquire (dest)), src_ (NasmAddress::acquire (src)) { };
+	~MovNasmInstruction () { NasmAddress::release (dest_); NasmAddress::release (src_); }
 
-	std::string toString () { return "mov   " + dest_->toString () + ", " + src_->toString (); }
+	void write (NasmWriter &out) { out << "mov   " << dest_ << ", " << src_; }
 	NasmInstructionType getInstructionType () const { return NI_MOV; }
 };
 
@@ -364,10 +533,10 @@ private:
 	AddNasmInstruction () { };
 
 public:
-	AddNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (dest), opr_ (opr) { };
-	~AddNasmInstruction () { delete dest_; delete opr_; }
+	AddNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (NasmAddress::acquire (dest)), opr_ (NasmAddress::acquire (opr)) { };
+	~AddNasmInstruction () { NasmAddress::release (dest_); NasmAddress::release (opr_); }
 
-	std::string toString () { return "add   " + dest_->toString () + ", " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "add   " << dest_ << ", " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_ADD; }
 };
 
@@ -380,10 +549,10 @@ private:
 	SubNasmInstruction () { };
 
 public:
-	SubNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (dest), opr_ (opr) { };
-	~SubNasmInstruction () { delete dest_; delete opr_; }
+	SubNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (NasmAddress::acquire (dest)), opr_ (NasmAddress::acquire (opr)) { };
+	~SubNasmInstruction () { NasmAddress::release (dest_); NasmAddress::release (opr_); }
 
-	std::string toString () { return "sub   " + dest_->toString () + ", " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "sub   " << dest_ << ", " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_SUB; }
 };
 
@@ -396,10 +565,10 @@ private:
 	ImulNasmInstruction () { };
 
 public:
-	ImulNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (dest), opr_ (opr) { };
-	~ImulNasmInstruction () { delete dest_; delete opr_; }
+	ImulNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (NasmAddress::acquire (dest)), opr_ (NasmAddress::acquire (opr)) { };
+	~ImulNasmInstruction () { NasmAddress::release (dest_); NasmAddress::release (opr_); }
 
-	std::string toString () { return "imul  " + dest_->toString () + ", " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "imul  " << dest_ << ", " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_IMUL; }
 };
 
@@ -411,13 +580,42 @@ private:
 	IdivNasmInstruction () { };
 
 public:
-	IdivNasmInstruction (NasmAddress *opr) : opr_ (opr) { };
-	~IdivNasmInstruction () { delete opr_; }
+	IdivNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~IdivNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return "idiv  dword " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "idiv  dword " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_IDIV; }
 };
 
+class DivNasmInstruction : public NasmInstruction
+{	// EAX = EDX:EAX / opr_ (unsigned)
+private:
+	NasmAddress *opr_;
+	// Hidden constructor
+	DivNasmInstruction () { };
+
+public:
+	DivNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~DivNasmInstruction () { NasmAddress::release (opr_); }
+
+	void write (NasmWriter &out) { out << "div   dword " << opr_; }
+	NasmInstructionType getInstructionType () const { return NI_DIV; }
+};
+
+class NegNasmInstruction : public NasmInstruction
+{
+private:
+	NasmAddress *op_;
+	// Hidden constructor
+	NegNasmInstruction () { };
+public:
+	NegNasmInstruction (NasmAddress *op) : op_ (NasmAddress::acquire (op)) { };
+	~NegNasmInstruction () { NasmAddress::release (op_); }
+
+	void write (NasmWriter &out) { out << "neg   " << op_; }
+	NasmInstructionType getInstructionType () const { return NI_NEG; }
+};
+
 class AndNasmInstruction : public NasmInstruction
 {
 private:
@@ -427,10 +625,10 @@ private:
 	AndNasmInstruction () { };
 
 public:
-	AndNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (dest), opr_ (opr) { };
-	~AndNasmInstruction () { delete dest_; delete opr_; }
+	AndNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (NasmAddress::acquire (dest)), opr_ (NasmAddress::acquire (opr)) { };
+	~AndNasmInstruction () { NasmAddress::release (dest_); NasmAddress::release (opr_); }
 
-	std::string toString () { return "and   " + dest_->toString () + ", " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "and   " << dest_ << ", " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_AND; }
 };
 
@@ -443,10 +641,10 @@ private:
 	OrNasmInstruction () { };
 
 public:
-	OrNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (dest), opr_ (opr) { };
-	~OrNasmInstruction () { delete dest_; delete opr_; }
+	OrNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (NasmAddress::acquire (dest)), opr_ (NasmAddress::acquire (opr)) { };
+	~OrNasmInstruction () { NasmAddress::release (dest_); NasmAddress::release (opr_); }
 
-	std::string toString () { return "or    " + dest_->toString () + ", " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "or    " << dest_ << ", " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_OR; }
 };
 
@@ -459,10 +657,10 @@ private:
 	XorNasmInstruction () { };
 
 public:
-	XorNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (dest), opr_ (opr) { };
-	~XorNasmInstruction () { delete dest_; delete opr_; }
+	XorNasmInstruction (NasmAddress *dest, NasmAddress *opr) : dest_ (NasmAddress::acquire (dest)), opr_ (NasmAddress::acquire (opr)) { };
+	~XorNasmInstruction () { NasmAddress::release (dest_); NasmAddress::release (opr_); }
 
-	std::string toString () { return "xor   " + dest_->toString () + ", " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "xor   " << dest_ << ", " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_XOR; }
 };
 
@@ -474,10 +672,10 @@ private:
 	FaddNasmInstruction () { };
 
 public:
-	FaddNasmInstruction (NasmAddress *opr) : opr_ (opr) { };
-	~FaddNasmInstruction () { delete opr_; }
+	FaddNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~FaddNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return "fadd  dword " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "fadd  dword " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_FADD; }
 };
 
@@ -489,10 +687,10 @@ private:
 	FsubNasmInstruction () { };
 
 public:
-	FsubNasmInstruction (NasmAddress *opr) : opr_ (opr) { };
-	~FsubNasmInstruction () { delete opr_; }
+	FsubNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~FsubNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return "fsub  dword " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "fsub  dword " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_FSUB; }
 };
 
@@ -504,10 +702,10 @@ private:
 	FmulNasmInstruction () { };
 
 public:
-	FmulNasmInstruction (NasmAddress *opr) : opr_ (opr) { };
-	~FmulNasmInstruction () { delete opr_; }
+	FmulNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~FmulNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return "fmul  dword " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "fmul  dword " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_FMUL; }
 };
 
@@ -519,10 +717,10 @@ private:
 	FdivNasmInstruction () { };
 
 public:
-	FdivNasmInstruction (NasmAddress *opr) : opr_ (opr) { };
-	~FdivNasmInstruction () { delete opr_; }
+	FdivNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~FdivNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return "fdiv  dword " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "fdiv  dword " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_FDIV; }
 };
 
@@ -534,10 +732,10 @@ private:
 	FcompNasmInstruction () { };
 
 public:
-	FcompNasmInstruction (NasmAddress *opr) : opr_ (opr) { };
-	~FcompNasmInstruction () { delete opr_; }
+	FcompNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~FcompNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return "fcomp dword " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "fcomp dword " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_FCOMP; }
 };
 
@@ -549,10 +747,10 @@ private:
 	FldNasmInstruction () { };
 
 public:
-	FldNasmInstruction (NasmAddress *opr) : opr_ (opr) { };
-	~FldNasmInstruction () { delete opr_; }
+	FldNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~FldNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return "fld   dword " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "fld   dword " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_FLD; }
 };
 
@@ -564,10 +762,10 @@ private:
 	FildNasmInstruction () { };
 
 public:
-	FildNasmInstruction (NasmAddress *opr) : opr_ (opr) { };
-	~FildNasmInstruction () { delete opr_; }
+	FildNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~FildNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return "fild  dword " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "fild  dword " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_FILD; }
 };
 
@@ -580,10 +778,10 @@ private:
 	FstpNasmInstruction () { };
 
 public:
-	FstpNasmInstruction (NasmAddress *opr) : opr_ (opr), is_qword_ (false) { };
-	~FstpNasmInstruction () { delete opr_; }
+	FstpNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)), is_qword_ (false) { };
+	~FstpNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return (is_qword_ ? "fstp  qword " : "fstp  dword ") + opr_->toString (); }
+	void write (NasmWriter &out) { out << (is_qword_ ? "fstp  qword " : "fstp  dword ") << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_FSTP; }
 
 	void setQword () { is_qword_ = true; }
@@ -599,10 +797,10 @@ private:
 	FistpNasmInstruction () { };
 
 public:
-	FistpNasmInstruction (NasmAddress *opr) : opr_ (opr), is_qword_ (false) { };
-	~FistpNasmInstruction () { delete opr_; }
+	FistpNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)), is_qword_ (false) { };
+	~FistpNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return (is_qword_ ? "fistp qword " : "fistp dword ") + opr_->toString (); }
+	void write (NasmWriter &out) { out << (is_qword_ ? "fistp qword " : "fistp dword ") << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_FSTP; }
 
 	void setQword () { is_qword_ = true; }
@@ -617,10 +815,10 @@ private:
 	PushNasmInstruction () { };
 
 public:
-	PushNasmInstruction (NasmAddress *opr) : opr_ (opr) { };
-	~PushNasmInstruction () { delete opr_; }
+	PushNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~PushNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return "push  dword " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "push  dword " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_PUSH; }
 };
 
@@ -631,10 +829,10 @@ private:
 	// Hidden constructor
 	PopNasmInstruction () { }
 public:
-	PopNasmInstruction (NasmAddress *opr) : opr_ (opr) { };
-	~PopNasmInstruction () { if (opr_ != nullptr) delete opr_; }
+	PopNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~PopNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return "pop   dword " + (opr_ != nullptr ? opr_->toString () : ""); }
+	void write (NasmWriter &out) { out << "pop   dword "; if (opr_ != nullptr) out << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_POP; }
 };
 
@@ -646,10 +844,10 @@ private:
 	// Hidden constructor
 	TestNasmInstruction () { };
 public:
-	TestNasmInstruction (NasmAddress *op1, NasmAddress *op2) : op1_ (op1), op2_ (op2) { };
-	~TestNasmInstruction () { delete op1_; delete op2_; }
+	TestNasmInstruction (NasmAddress *op1, NasmAddress *op2) : op1_ (NasmAddress::acquire (op1)), op2_ (NasmAddress::acquire (op2)) { };
+	~TestNasmInstruction () { NasmAddress::release (op1_); NasmAddress::release (op2_); }
 
-	std::string toString () { return "test  " + op1_->toString () + ", " + op2_->toString (); }
+	void write (NasmWriter &out) { out << "test  " << op1_ << ", " << op2_; }
 	NasmInstructionType getInstructionType () const { return NI_TEST; }
 };
 
@@ -661,10 +859,10 @@ private:
 	// Hidden constructor
 	CmpNasmInstruction () { };
 public:
-	CmpNasmInstruction (NasmAddress *op1, NasmAddress *op2) : op1_ (op1), op2_ (op2) { };
-	~CmpNasmInstruction () { delete op1_; delete op2_; }
+	CmpNasmInstruction (NasmAddress *op1, NasmAddress *op2) : op1_ (NasmAddress::acquire (op1)), op2_ (NasmAddress::acquire (op2)) { };
+	~CmpNasmInstruction () { NasmAddress::release (op1_); NasmAddress::release (op2_); }
 
-	std::string toString () { return "cmp   " + op1_->toString () + ", " + op2_->toString (); }
+	void write (NasmWriter &out) { out << "cmp   " << op1_ << ", " << op2_; }
 	NasmInstructionType getInstructionType () const { return NI_CMP; }
 };
 
@@ -678,7 +876,7 @@ private:
 public:
 	JmpNasmInstruction (std::string target) : target_ (target) { };
 
-	std::string toString () { return "jmp   " + target_; }
+	void write (NasmWriter &out) { out << "jmp   " << target_; }
 	NasmInstructionType getInstructionType () const { return NI_JMP; }
 };
 
@@ -693,7 +891,7 @@ private:
 public:
 	JxxNasmInstruction (std::string target, std::string suffix) : target_ (target), suffix_ (suffix) { };
 
-	std::string toString () { return "j" + suffix_ + " " + target_; }
+	void write (NasmWriter &out) { out << "j" << suffix_ << " " << target_; }
 	NasmInstructionType getInstructionType () const { return NI_JXX; }
 };
 
@@ -706,9 +904,10 @@ private:
 	SetxxNasmInstruction () { }
 
 public:
-	SetxxNasmInstruction (NasmAddress *target, std::string suffix) : target_ (target), suffix_ (suffix) { };
+	SetxxNasmInstruction (NasmAddress *target, std::string suffix) : target_ (NasmAddress::acquire (target)), suffix_ (suffix) { };
+	~SetxxNasmInstruction () { NasmAddress::release (target_); }
 
-	std::string toString () { return "set" + suffix_ + " " + target_->toString (); }
+	void write (NasmWriter &out) { out << "set" << suffix_ << " " << target_; }
 	NasmInstructionType getInstructionType () const { return NI_SETXX; }
 };
 
@@ -723,9 +922,10 @@ private:
 
 public:
 	CmovxxNasmInstruction (NasmAddress *dest, NasmAddress *src, std::string suffix) :
-		dest_ (dest), src_ (src), suffix_ (suffix) { };
+		dest_ (NasmAddress::acquire (dest)), src_ (NasmAddress::acquire (src)), suffix_ (suffix) { };
+	~CmovxxNasmInstruction () { NasmAddress::release (dest_); NasmAddress::release (src_); }
 
-	std::string toString () { return "cmov" + suffix_ + " " + dest_->toString () + ", " + src_->toString (); }
+	void write (NasmWriter &out) { out << "cmov" << suffix_ << " " << dest_ << ", " << src_; }
 	NasmInstructionType getInstructionType () const { return NI_CMOVXX; }
 };
 
@@ -737,10 +937,10 @@ private:
 	FstswNasmInstruction () { };
 
 public:
-	FstswNasmInstruction (NasmAddress *opr) : opr_ (opr) { };
-	~FstswNasmInstruction () { delete opr_; }
+	FstswNasmInstruction (NasmAddress *opr) : opr_ (NasmAddress::acquire (opr)) { };
+	~FstswNasmInstruction () { NasmAddress::release (opr_); }
 
-	std::string toString () { return "fstsw " + opr_->toString (); }
+	void write (NasmWriter &out) { out << "fstsw " << opr_; }
 	NasmInstructionType getInstructionType () const { return NI_FSTSW; }
 };
 
@@ -749,7 +949,7 @@ class SahfNasmInstruction : public NasmInstruction
 public:
 	SahfNasmInstruction () { };
 
-	std::string toString () { return "sahf"; }
+	void write (NasmWriter &out) { out << "sahf"; }
 	NasmInstructionType getInstructionType () const { return NI_SAHF; }
 };
 
@@ -758,16 +958,29 @@ class FwaitNasmInstruction : public NasmInstruction
 public:
 	FwaitNasmInstruction () { };
 
-	std::string toString () { return "fwait"; }
+	void write (NasmWriter &out) { out << "fwait"; }
 	NasmInstructionType getInstructionType () const { return NI_FWAIT; }
 };
 
+class MovsbNasmInstruction : public NasmInstruction
+{
+private:
+	// Repeat ECX times
+	bool rep_;
+
+public:
+	MovsbNasmInstruction (bool rep) : rep_ (rep) { };
+
+	void write (NasmWriter &out) { out << (rep_ ? "rep movsb" : "movsb"); }
+	NasmInstructionType getInstructionType () const { return NI_MOVSB; }
+};
+
 class RetNasmInstruction : public NasmInstruction
 {
 public:
 	RetNasmInstruction () { };
 
-	std::string toString () { return "ret"; }
+	void write (NasmWriter &out) { out << "ret"; }
 	NasmInstructionType getInstructionType () const { return NI_RET; }
 };
 
@@ -781,7 +994,9 @@ protected:
 public:
 	CallNasmInstruction (std::string function) : function_ (function) { }
 
-	std::string toString () { return "call  " + function_; }
+	const std::string &getFunction () const { return function_; }
+
+	void write (NasmWriter &out) { out << "call  " << function_; }
 	NasmInstructionType getInstructionType () const { return NI_CALL; }
 };
 
@@ -0,0 +1,167 @@
+#include "x86-nasm-writer.h"
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include "error/error.h"
+#include "backends/interface/tool-runner.h"
+
+NasmWriter::NasmWriter ()
+{
+	fd_ = -1;
+	buffer_ = new char[NASM_WRITER_BUFFER_SIZE];
+	length_ = 0;
+	flushed_ = 0;
+	failed_ = false;
+}
+
+NasmWriter::~NasmWriter ()
+{
+	close ();
+	delete[] buffer_;
+}
+
+int NasmWriter::open (std::string file_name)
+{
+	fd_ = ::open (file_name.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd_ < 0)
+	{
+		Error::internalError ("[x86-nasm] cannot open '" + file_name + "' for writing: " + strerror (errno));
+		return ER_FAILED;
+	}
+
+	return NO_ERROR;
+}
+
+int NasmWriter::openMemory (std::string name)
+{
+	fd_ = ToolRunner::createMemoryFile (name);
+	return (fd_ >= 0 ? NO_ERROR : ER_FAILED);
+}
+
+void NasmWriter::writeOut (const char *data, unsigned int size)
+{
+	unsigned int written = 0;
+	while (fd_ >= 0 && !failed_ && written < size)
+	{
+		ssize_t rc = ::write (fd_, data + written, size - written);
+		if (rc < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (rc <= 0)
+		{
+			failed_ = true;
+			break;
+		}
+		written += rc;
+	}
+
+	flushed_ += size;
+}
+
+int NasmWriter::flush ()
+{
+	writeOut (buffer_, length_);
+	length_ = 0;
+
+	return (failed_ ? ER_FAILED : NO_ERROR);
+}
+
+int NasmWriter::close ()
+{
+	if (fd_ < 0)
+	{
+		return NO_ERROR;
+	}
+
+	int rc = flush ();
+	::close (fd_);
+	fd_ = -1;
+
+	return rc;
+}
+
+void NasmWriter::write (const char *data, unsigned int size)
+{
+	if (size > NASM_WRITER_BUFFER_SIZE)
+	{
+		// Too large to be buffered, write it directly
+		flush ();
+		writeOut (data, size);
+		return;
+	}
+
+	reserve (size);
+	memcpy (buffer_ + length_, data, size);
+	length_ += size;
+}
+
+void NasmWriter::writeHex (unsigned int value)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	char digits[8];
+	int count = 0;
+	do
+	{
+		digits[count ++] = hex[value & 0xf];
+		value >>= 4;
+	}
+	while (value != 0);
+
+	reserve (count);
+	while (count > 0)
+	{
+		buffer_[length_ ++] = digits[-- count];
+	}
+}
+
+void NasmWriter::pad (unsigned long line_start, unsigned int column)
+{
+	unsigned long length = tell () - line_start;
+	if (length < column)
+	{
+		unsigned int spaces = column - length;
+		reserve (spaces);
+		memset (buffer_ + length_, ' ', spaces);
+		length_ += spaces;
+	}
+}
+
+NasmWriter &NasmWriter::operator<< (const char *str)
+{
+	write (str, strlen (str));
+	return *this;
+}
+
+NasmWriter &NasmWriter::operator<< (unsigned int value)
+{
+	char digits[10];
+	int count = 0;
+	do
+	{
+		digits[count ++] = '0' + value % 10;
+		value /= 10;
+	}
+	while (value != 0);
+
+	reserve (count);
+	while (count > 0)
+	{
+		buffer_[length_ ++] = digits[-- count];
+	}
+
+	return *this;
+}
+
+NasmWriter &NasmWriter::operator<< (int value)
+{
+	if (value < 0)
+	{
+		*this << '-';
+		return *this << (unsigned int) (- (long) value);
+	}
+
+	return *this << (unsigned int) value;
+}
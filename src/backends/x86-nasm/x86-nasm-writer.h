@@ -0,0 +1,72 @@
+#ifndef X86_NASM_WRITER_H_
+#define X86_NASM_WRITER_H_
+
+#include <string>
+
+//
+// Size of the assembly output buffer
+//
+#define NASM_WRITER_BUFFER_SIZE		(1 << 20)
+
+//
+// Buffered assembly writer
+// Text is formatted straight into a large buffer, which is written to the file
+// descriptor only when it fills up or when the writer is flushed
+//
+class NasmWriter
+{
+private:
+	int fd_;
+	char *buffer_;
+	unsigned int length_;
+	// Bytes written to the descriptor so far
+	unsigned long flushed_;
+	// A write to the descriptor failed
+	bool failed_;
+
+	// Write data to the descriptor
+	void writeOut (const char *data, unsigned int size);
+
+	// Make room for size bytes
+	void reserve (unsigned int size) { if (length_ + size > NASM_WRITER_BUFFER_SIZE) flush (); }
+
+public:
+	NasmWriter ();
+	~NasmWriter ();
+
+	// Open a file for writing
+	int open (std::string file_name);
+
+	// Open an anonymous in-memory file (Linux memfd)
+	int openMemory (std::string name);
+
+	// Write the buffer to the descriptor
+	int flush ();
+
+	// Flush and close the descriptor
+	int close ();
+
+	// Get the descriptor
+	int getDescriptor () const { return fd_; }
+
+	// Bytes written so far, including the buffered ones
+	unsigned long tell () const { return flushed_ + length_; }
+
+	// Append raw data
+	void write (const char *data, unsigned int size);
+
+	// Append an unsigned value in hexadecimal, without prefix
+	void writeHex (unsigned int value);
+
+	// Pad with spaces up to the given column of the line starting at line_start
+	void pad (unsigned long line_start, unsigned int column);
+
+	// Append text and numbers
+	NasmWriter &operator<< (const char *str);
+	NasmWriter &operator<< (const std::string &str) { write (str.data (), str.length ()); return *this; }
+	NasmWriter &operator<< (char c) { reserve (1); buffer_[length_ ++] = c; return *this; }
+	NasmWriter &operator<< (unsigned int value);
+	NasmWriter &operator<< (int value);
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "batch-compiler.h"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include "error/error.h"
+#include "thread-pool.h"
+
+BatchCompiler::~BatchCompiler ()
+{
+	for (unsigned int i = 0; i < jobs_.size (); i ++)
+	{
+		delete jobs_[i];
+	}
+}
+
+void BatchCompiler::addInput (std::string input_file)
+{
+	BatchJob *job = new BatchJob ();
+	job->options = options_;
+	job->options.input_file = input_file;
+	job->options.output_file = input_file + ".out";
+	job->ret_code = ER_FAILED;
+	job->cache_hit = false;
+	job->done = false;
+
+	jobs_.push_back (job);
+}
+
+int BatchCompiler::addManifest (std::string manifest_file)
+{
+	std::ifstream manifest (manifest_file);
+	if (!manifest.good ())
+	{
+		Error::error ("failed to open manifest '" + manifest_file + "'");
+		return ER_FAILED;
+	}
+
+	std::string line;
+	while (std::getline (manifest, line))
+	{
+		// Trim whitespace
+		size_t start = line.find_first_not_of (" \t\r");
+		if (start == std::string::npos || line[start] == '#')
+		{
+			continue;
+		}
+		size_t end = line.find_last_not_of (" \t\r");
+
+		addInput (line.substr (start, end - start + 1));
+	}
+
+	return NO_ERROR;
+}
+
+void BatchCompiler::compileJob (BatchJob *job)
+{
+	Compilation compilation (job->options);
+	compilation.setOutput (job->output);
+	compilation.setDiagnostics (job->diagnostics);
+	int rc = compilation.run ();
+
+	std::lock_guard<std::mutex> lock (mutex_);
+	job->ret_code = rc;
+	job->cache_hit = compilation.isCacheHit ();
+	job->done = true;
+	job_done_.notify_all ();
+}
+
+void BatchCompiler::reportJob (unsigned int index)
+{
+	BatchJob *job = jobs_[index];
+
+	std::cout << "[batch] (" << index + 1 << "/" << jobs_.size () << ") " << job->options.input_file << std::endl;
+	std::cout << job->output.str () << std::flush;
+	std::cerr << job->diagnostics.str () << std::flush;
+
+	if (job->ret_code != NO_ERROR)
+	{
+		Error::error ("failed to compile '" + job->options.input_file + "'");
+	}
+}
+
+int BatchCompiler::run (unsigned int threads)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+
+	// No point in more threads than files
+	unsigned int workers = (threads > 0 ? threads : ThreadPool::getCoreCount ());
+	if (workers > jobs_.size ())
+	{
+		workers = jobs_.size ();
+	}
+	if (workers == 0)
+	{
+		return NO_ERROR;
+	}
+
+	ThreadPool pool (workers);
+	for (unsigned int i = 0; i < jobs_.size (); i ++)
+	{
+		BatchJob *job = jobs_[i];
+		pool.submit ([this, job] () { compileJob (job); });
+	}
+	pool.start ();
+
+	// Report files in order, while the rest are still compiling
+	unsigned int failed = 0;
+	unsigned int cache_hits = 0;
+	for (unsigned int i = 0; i < jobs_.size (); i ++)
+	{
+		{
+			std::unique_lock<std::mutex> lock (mutex_);
+			while (!jobs_[i]->done)
+			{
+				job_done_.wait (lock);
+			}
+		}
+
+		reportJob (i);
+		if (jobs_[i]->ret_code != NO_ERROR)
+		{
+			failed ++;
+		}
+		if (jobs_[i]->cache_hit)
+		{
+			cache_hits ++;
+		}
+	}
+	pool.wait ();
+
+	unsigned int elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now () - start).count ();
+	std::cout << "[batch] " << jobs_.size () - failed << " of " << jobs_.size () << " files compiled on "
+			  << workers << " threads in " << elapsed_ms << " ms";
+	if (!options_.cache_directory.empty ())
+	{
+		std::cout << ", " << cache_hits << " from cache";
+	}
+	std::cout << std::endl;
+
+	return (failed == 0 ? NO_ERROR : ER_FAILED);
+}
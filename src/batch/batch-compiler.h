@@ -0,0 +1,65 @@
+#ifndef BATCH_COMPILER_H_
+#define BATCH_COMPILER_H_
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <mutex>
+#include <condition_variable>
+#include "compilation.h"
+
+//
+// Batch compiler
+// Compiles many source files in parallel on a work-stealing thread pool, each one into
+// the executable named after it. The output and errors of every file are captured and
+// reported in input order, as soon as the file and all the ones before it are done.
+//
+class BatchCompiler
+{
+private:
+	// A file of the batch
+	struct BatchJob
+	{
+		CompilationOptions options;
+		std::ostringstream output;
+		std::ostringstream diagnostics;
+		int ret_code;
+		bool cache_hit;
+		bool done;
+	};
+
+	// Options shared by all files
+	CompilationOptions options_;
+
+	std::vector<BatchJob *> jobs_;
+
+	// Guards the done flags of the jobs
+	std::mutex mutex_;
+	std::condition_variable job_done_;
+
+	// Compile a file, called on a pool thread
+	void compileJob (BatchJob *job);
+
+	// Print the captured output and errors of a finished file
+	void reportJob (unsigned int index);
+
+public:
+	BatchCompiler (const CompilationOptions &options) : options_ (options) { }
+	~BatchCompiler ();
+
+	// Add a source file
+	void addInput (std::string input_file);
+
+	// Add the source files listed in a manifest, one per line; empty lines and lines
+	// starting with '#' are ignored
+	int addManifest (std::string manifest_file);
+
+	// Get the number of source files
+	unsigned int getInputCount () const { return jobs_.size (); }
+
+	// Compile all files using the given number of threads (0 for one per core)
+	// Returns NO_ERROR if all files compiled
+	int run (unsigned int threads);
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include "thread-pool.h"
+
+unsigned int ThreadPool::getCoreCount ()
+{
+	unsigned int cores = std::thread::hardware_concurrency ();
+
+	// Zero if unknown
+	return (cores > 0 ? cores : 1);
+}
+
+ThreadPool::ThreadPool (unsigned int workers)
+{
+	for (unsigned int i = 0; i < workers; i ++)
+	{
+		queues_.push_back (new WorkerQueue ());
+	}
+	next_queue_ = 0;
+	queued_ = 0;
+	stopping_ = false;
+}
+
+ThreadPool::~ThreadPool ()
+{
+	wait ();
+
+	for (unsigned int i = 0; i < queues_.size (); i ++)
+	{
+		delete queues_[i];
+	}
+}
+
+void ThreadPool::submit (ThreadPoolTask task)
+{
+	std::lock_guard<std::mutex> lock (mutex_);
+
+	WorkerQueue *queue = queues_[next_queue_];
+	next_queue_ = (next_queue_ + 1) % queues_.size ();
+	{
+		std::lock_guard<std::mutex> queue_lock (queue->mutex);
+		queue->tasks.push_back (task);
+	}
+
+	queued_ ++;
+	wake_.notify_one ();
+}
+
+bool ThreadPool::takeTask (unsigned int worker, ThreadPoolTask &task)
+{
+	bool taken = false;
+
+	// Own queue, oldest task first, then steal the newest task of another worker, the
+	// one it would get to last
+	for (unsigned int i = 0; i < queues_.size () && !taken; i ++)
+	{
+		WorkerQueue *queue = queues_[(worker + i) % queues_.size ()];
+		std::lock_guard<std::mutex> lock (queue->mutex);
+		if (!queue->tasks.empty ())
+		{
+			if (i == 0)
+			{
+				task = queue->tasks.front ();
+				queue->tasks.pop_front ();
+			}
+			else
+			{
+				task = queue->tasks.back ();
+				queue->tasks.pop_back ();
+			}
+			taken = true;
+		}
+	}
+
+	if (taken)
+	{
+		std::lock_guard<std::mutex> lock (mutex_);
+		queued_ --;
+	}
+
+	return taken;
+}
+
+void ThreadPool::work (unsigned int worker)
+{
+	ThreadPoolTask task;
+	while (true)
+	{
+		if (takeTask (worker, task))
+		{
+			task ();
+			continue;
+		}
+
+		// Sleep until there is work, unless a task was submitted in the meantime
+		std::unique_lock<std::mutex> lock (mutex_);
+		if (queued_ > 0)
+		{
+			continue;
+		}
+		if (stopping_)
+		{
+			break;
+		}
+		wake_.wait (lock);
+	}
+}
+
+void ThreadPool::start ()
+{
+	for (unsigned int i = 0; i < queues_.size (); i ++)
+	{
+		threads_.push_back (std::thread (&ThreadPool::work, this, i));
+	}
+}
+
+void ThreadPool::wait ()
+{
+	{
+		std::lock_guard<std::mutex> lock (mutex_);
+		stopping_ = true;
+		wake_.notify_all ();
+	}
+
+	for (unsigned int i = 0; i < threads_.size (); i ++)
+	{
+		threads_[i].join ();
+	}
+	threads_.clear ();
+}
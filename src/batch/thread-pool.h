@@ -0,0 +1,73 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+//
+// Pool task
+//
+typedef std::function<void ()> ThreadPoolTask;
+
+//
+// Work-stealing thread pool
+// Tasks are dealt round-robin to per-worker queues. A worker runs its own queue from the
+// front, so tasks finish roughly in submission order, and when it runs dry steals from
+// the back of the other queues. Workers with nothing to do sleep until a task is
+// submitted or the pool is stopped.
+//
+class ThreadPool
+{
+private:
+	// Task queue of a worker
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<ThreadPoolTask> tasks;
+	};
+
+	std::vector<WorkerQueue *> queues_;
+	std::vector<std::thread> threads_;
+
+	// Queue the next submitted task goes to
+	unsigned int next_queue_;
+
+	// Guards the task count and the stopping flag, idle workers wait on wake_
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	// Tasks submitted and not yet taken
+	unsigned int queued_;
+	// No more tasks will be submitted
+	bool stopping_;
+
+	// Take a task from the worker's own queue, or steal one from another queue
+	bool takeTask (unsigned int worker, ThreadPoolTask &task);
+
+	// Worker thread body
+	void work (unsigned int worker);
+
+public:
+	ThreadPool (unsigned int workers);
+	~ThreadPool ();
+
+	// Get the number of cores, at least 1
+	static unsigned int getCoreCount ();
+
+	// Get the number of workers
+	unsigned int getWorkerCount () const { return queues_.size (); }
+
+	// Add a task, before or after the pool is started
+	void submit (ThreadPoolTask task);
+
+	// Start the workers
+	void start ();
+
+	// Stop accepting tasks, wait for all submitted ones to finish and stop the workers
+	void wait ();
+};
+
+#endif
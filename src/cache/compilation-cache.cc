@@ -0,0 +1,425 @@
+#include "compilation-cache.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <ctime>
+#include <vector>
+#include <tuple>
+#include <algorithm>
+#include <mutex>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "configure.h"
+#include "error/error.h"
+
+//
+// Entry file header, followed by the key text and the executable
+//
+#define CACHE_ENTRY_MAGIC				"cbasic-cache"
+
+//
+// Temporary files older than this are leftovers of killed processes
+//
+#define CACHE_STALE_SECONDS				3600
+
+//
+// 64bit FNV-1a hash
+//
+static unsigned long long fnv1a (const std::string &data)
+{
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	for (unsigned char c : data)
+	{
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+//
+// Hash of the runtime library, kept while the archive is unchanged so that a
+// long-running process (batch or server) reads it only once
+//
+static std::mutex runtime_mutex;
+static std::string runtime_hash;
+static struct timespec runtime_mtime;
+static off_t runtime_size;
+
+//
+// Hash of the running compiler, so that entries of a compiler generating different
+// code are never used; read once, the running executable doesn't change
+//
+static std::string compiler_hash;
+
+//
+// Read a whole file
+//
+static int read_file (std::string path, std::string &data)
+{
+	int fd = ::open (path.c_str (), O_RDONLY);
+	if (fd < 0)
+	{
+		return ER_FAILED;
+	}
+
+	data.clear ();
+	char buffer[65536];
+	ssize_t length;
+	while ((length = read (fd, buffer, sizeof (buffer))) != 0)
+	{
+		if (length < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			close (fd);
+			return ER_FAILED;
+		}
+		data.append (buffer, length);
+	}
+
+	close (fd);
+	return NO_ERROR;
+}
+
+//
+// Write a whole buffer to a descriptor
+//
+static int write_all (int fd, const char *data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t length = write (fd, data, size);
+		if (length < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (length <= 0)
+		{
+			return ER_FAILED;
+		}
+		data += length;
+		size -= length;
+	}
+	return NO_ERROR;
+}
+
+//
+// Write a file under a temporary name next to path and rename it into place
+//
+static int write_file_atomic (std::string path, const char *data, size_t size, mode_t mode)
+{
+	std::string temporary = path + ".tmp.XXXXXX";
+	std::vector<char> name (temporary.begin (), temporary.end ());
+	name.push_back ('\0');
+
+	int fd = mkstemp (name.data ());
+	if (fd < 0)
+	{
+		return ER_FAILED;
+	}
+
+	if (write_all (fd, data, size) != NO_ERROR || fchmod (fd, mode) != 0)
+	{
+		close (fd);
+		unlink (name.data ());
+		return ER_FAILED;
+	}
+	close (fd);
+
+	if (rename (name.data (), path.c_str ()) != 0)
+	{
+		unlink (name.data ());
+		return ER_FAILED;
+	}
+
+	return NO_ERROR;
+}
+
+int CompilationCache::open ()
+{
+	// Create all missing directories of the path
+	for (size_t slash = directory_.find ('/', 1); ; slash = directory_.find ('/', slash + 1))
+	{
+		std::string path = directory_.substr (0, slash);
+		if (mkdir (path.c_str (), 0755) != 0 && errno != EEXIST)
+		{
+			Error::error ("cannot create cache directory '" + path + "'");
+			return ER_FAILED;
+		}
+
+		if (slash == std::string::npos)
+		{
+			break;
+		}
+	}
+
+	return NO_ERROR;
+}
+
+int CompilationCache::computeKey (const CompilationOptions &options, CacheKey &key)
+{
+	std::string source;
+	if (read_file (options.input_file, source) != NO_ERROR)
+	{
+		return ER_FAILED;
+	}
+
+	// The runtime library is linked into the executable
+	struct stat st;
+	if (stat (LIBCBASIC_ARCHIVE, &st) != 0)
+	{
+		return ER_FAILED;
+	}
+
+	std::unique_lock<std::mutex> lock (runtime_mutex);
+	if (runtime_hash.empty () || st.st_size != runtime_size
+		|| st.st_mtim.tv_sec != runtime_mtime.tv_sec || st.st_mtim.tv_nsec != runtime_mtime.tv_nsec)
+	{
+		std::string runtime;
+		if (read_file (LIBCBASIC_ARCHIVE, runtime) != NO_ERROR)
+		{
+			return ER_FAILED;
+		}
+
+		char hash[17];
+		snprintf (hash, sizeof (hash), "%016llx", fnv1a (runtime));
+		runtime_hash = hash;
+		runtime_mtime = st.st_mtim;
+		runtime_size = st.st_size;
+	}
+	std::string runtime = runtime_hash;
+
+	if (compiler_hash.empty ())
+	{
+		std::string compiler;
+		if (read_file ("/proc/self/exe", compiler) != NO_ERROR)
+		{
+			return ER_FAILED;
+		}
+
+		char hash[17];
+		snprintf (hash, sizeof (hash), "%016llx", fnv1a (compiler));
+		compiler_hash = hash;
+	}
+	std::string compiler = compiler_hash;
+	lock.unlock ();
+
+	key.text = "cbasic " + std::to_string (VERSION_MAJOR) + "." + std::to_string (VERSION_MINOR) + "\n"
+			   + "compiler " + compiler + "\n"
+			   + "backend " + options.backend_target + "\n"
+			   + "unroll " + std::to_string (options.unroll_factor) + "\n"
+			   + "static " + std::to_string (options.static_linking) + "\n"
+			   + "runtime " + runtime + "\n"
+			   + "source " + std::to_string (source.size ()) + "\n"
+			   + source;
+
+	char hash[17];
+	snprintf (hash, sizeof (hash), "%016llx", fnv1a (key.text));
+	key.hash = hash;
+
+	return NO_ERROR;
+}
+
+bool CompilationCache::lookup (const CacheKey &key, std::string output_file)
+{
+	std::string path = getEntryPath (key.hash);
+	std::string entry;
+	bool hit = false;
+
+	if (read_file (path, entry) == NO_ERROR)
+	{
+		// Check the header and the key text
+		char magic[32];
+		unsigned long text_size = 0, executable_size = 0;
+		int header_size = 0;
+		if (sscanf (entry.c_str (), "%31s %lu %lu\n%n", magic, &text_size, &executable_size, &header_size) == 3
+			&& header_size > 0
+			&& std::string (magic) == CACHE_ENTRY_MAGIC
+			&& entry.size () == header_size + text_size + executable_size
+			&& entry.compare (header_size, text_size, key.text) == 0)
+		{
+			const char *executable = entry.data () + header_size + text_size;
+			hit = (write_file_atomic (output_file, executable, executable_size, 0755) == NO_ERROR);
+		}
+	}
+
+	if (hit)
+	{
+		// Mark as recently used
+		utimensat (AT_FDCWD, path.c_str (), nullptr, 0);
+		updateStats (1, 0, 0);
+	}
+	else
+	{
+		updateStats (0, 1, 0);
+	}
+
+	return hit;
+}
+
+int CompilationCache::store (const CacheKey &key, std::string output_file)
+{
+	std::string executable;
+	if (read_file (output_file, executable) != NO_ERROR)
+	{
+		return ER_FAILED;
+	}
+
+	std::string entry = std::string (CACHE_ENTRY_MAGIC) + " " + std::to_string (key.text.size ())
+						+ " " + std::to_string (executable.size ()) + "\n" + key.text + executable;
+	if (write_file_atomic (getEntryPath (key.hash), entry.data (), entry.size (), 0644) != NO_ERROR)
+	{
+		return ER_FAILED;
+	}
+
+	if (updateStats (0, 0, entry.size ()) > max_size_)
+	{
+		evict ();
+	}
+
+	return NO_ERROR;
+}
+
+unsigned long CompilationCache::updateStats (unsigned long hits, unsigned long misses, long size_delta, bool reset_size, unsigned long size)
+{
+	int fd = ::open (getStatsPath ().c_str (), O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		return 0;
+	}
+
+	// Other processes update the file too
+	flock (fd, LOCK_EX);
+
+	char buffer[256];
+	ssize_t length = pread (fd, buffer, sizeof (buffer) - 1, 0);
+	buffer[length > 0 ? length : 0] = '\0';
+
+	unsigned long old_hits = 0, old_misses = 0, old_size = 0;
+	sscanf (buffer, "hits %lu\nmisses %lu\nsize %lu\n", &old_hits, &old_misses, &old_size);
+
+	if (!reset_size)
+	{
+		size = (size_delta < 0 && (unsigned long) -size_delta > old_size ? 0 : old_size + size_delta);
+	}
+	length = snprintf (buffer, sizeof (buffer), "hits %lu\nmisses %lu\nsize %lu\n", old_hits + hits, old_misses + misses, size);
+	if (pwrite (fd, buffer, length, 0) == length)
+	{
+		ftruncate (fd, length);
+	}
+
+	flock (fd, LOCK_UN);
+	close (fd);
+
+	return size;
+}
+
+void CompilationCache::evict ()
+{
+	// One process evicts at a time, the others carry on
+	int lock_fd = ::open ((directory_ + "/evict.lock").c_str (), O_RDWR | O_CREAT, 0644);
+	if (lock_fd < 0)
+	{
+		return;
+	}
+	if (flock (lock_fd, LOCK_EX | LOCK_NB) != 0)
+	{
+		close (lock_fd);
+		return;
+	}
+
+	DIR *dir = opendir (directory_.c_str ());
+	if (dir == nullptr)
+	{
+		close (lock_fd);
+		return;
+	}
+
+	// Gather entries, oldest use first
+	std::vector<std::tuple<time_t, unsigned long, std::string>> entries;
+	unsigned long total = 0;
+	time_t now = time (nullptr);
+	struct dirent *de;
+	while ((de = readdir (dir)) != nullptr)
+	{
+		std::string name = de->d_name;
+		std::string path = directory_ + "/" + name;
+		struct stat st;
+		if (stat (path.c_str (), &st) != 0)
+		{
+			continue;
+		}
+
+		if (name.find (".tmp.") != std::string::npos)
+		{
+			if (now - st.st_mtime > CACHE_STALE_SECONDS)
+			{
+				unlink (path.c_str ());
+			}
+		}
+		else if (name.size () > 6 && name.compare (name.size () - 6, 6, ".entry") == 0)
+		{
+			entries.push_back (std::make_tuple (st.st_mtime, (unsigned long) st.st_size, path));
+			total += st.st_size;
+		}
+	}
+	closedir (dir);
+	std::sort (entries.begin (), entries.end ());
+
+	// Evict down to three quarters of the bound, so that evictions are not run for
+	// every new entry. Readers that already opened an evicted entry are unaffected
+	for (unsigned int i = 0; i < entries.size () && total > max_size_ / 4 * 3; i ++)
+	{
+		if (unlink (std::get<2> (entries[i]).c_str ()) == 0)
+		{
+			total -= std::get<1> (entries[i]);
+		}
+	}
+
+	updateStats (0, 0, 0, true, total);
+
+	flock (lock_fd, LOCK_UN);
+	close (lock_fd);
+}
+
+void CompilationCache::printStatistics (std::ostream &stream)
+{
+	unsigned int count = 0;
+	unsigned long total = 0;
+
+	DIR *dir = opendir (directory_.c_str ());
+	if (dir != nullptr)
+	{
+		struct dirent *de;
+		while ((de = readdir (dir)) != nullptr)
+		{
+			std::string name = de->d_name;
+			struct stat st;
+			if (name.size () > 6 && name.compare (name.size () - 6, 6, ".entry") == 0
+				&& stat ((directory_ + "/" + name).c_str (), &st) == 0)
+			{
+				count ++;
+				total += st.st_size;
+			}
+		}
+		closedir (dir);
+	}
+
+	std::string stats;
+	unsigned long hits = 0, misses = 0;
+	if (read_file (getStatsPath (), stats) == NO_ERROR)
+	{
+		sscanf (stats.c_str (), "hits %lu\nmisses %lu\n", &hits, &misses);
+	}
+
+	stream << "Cache directory:  " << directory_ << std::endl;
+	stream << "Entries:          " << count << std::endl;
+	stream << "Size:             " << total << " of " << max_size_ << " bytes" << std::endl;
+	stream << "Hits:             " << hits << std::endl;
+	stream << "Misses:           " << misses << std::endl;
+}
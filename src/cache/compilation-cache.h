@@ -0,0 +1,67 @@
+#ifndef COMPILATION_CACHE_H_
+#define COMPILATION_CACHE_H_
+
+#include <string>
+#include <ostream>
+#include "compilation.h"
+
+//
+// Default size bound of the cache
+//
+#define CACHE_SIZE_DEFAULT				(256UL << 20)
+
+//
+// Cache key
+// The key text holds everything the executable depends on: compiler version, backend
+// target, options, runtime library and the source itself. Entries are addressed by a
+// hash of the text and store the text, so a hash collision is detected and is a miss.
+//
+struct CacheKey
+{
+	std::string text;
+	std::string hash;
+};
+
+//
+// Content-addressed on-disk cache of compiled executables
+// Every entry is a single file, written under a temporary name and renamed into place,
+// so concurrent processes only ever see complete entries. Lookups refresh the entry's
+// modification time, which orders the size-bounded LRU eviction. Hit and miss counters
+// and the approximate total size are kept in a stats file updated under a file lock.
+//
+class CompilationCache
+{
+private:
+	std::string directory_;
+	unsigned long max_size_;
+
+	// Get the path of an entry or of the stats file
+	std::string getEntryPath (const std::string &hash) const { return directory_ + "/" + hash + ".entry"; }
+	std::string getStatsPath () const { return directory_ + "/stats"; }
+
+	// Update the stats file; returns the total size after the update
+	unsigned long updateStats (unsigned long hits, unsigned long misses, long size_delta, bool reset_size = false, unsigned long size = 0);
+
+	// Remove least recently used entries until the cache fits its size bound
+	void evict ();
+
+public:
+	CompilationCache (std::string directory, unsigned long max_size) : directory_ (directory), max_size_ (max_size) { }
+
+	// Create the cache directory if needed
+	int open ();
+
+	// Compute the key of a compilation; fails if the source can't be read
+	int computeKey (const CompilationOptions &options, CacheKey &key);
+
+	// Copy the cached executable of a key to the output file; returns true on a hit
+	bool lookup (const CacheKey &key, std::string output_file);
+
+	// Store the executable built for a key
+	int store (const CacheKey &key, std::string output_file);
+
+	// Print entry count, size and hit/miss counters
+	void printStatistics (std::ostream &stream);
+};
+
+#endif
@@ -1,15 +1,28 @@
 #include <iostream>
 #include <cassert>
 #include <string>
+#include <vector>
 #include <getopt.h>
 
 #include "configure.h"
 #include "error/error.h"
 #include "verbose.h"
-#include "parser/parser-context.h"
-#include "symbols/symbol-table.h"
-#include "ilang/il-program.h"
-#include "backends/interface/backend.h"
+#include "optimizations.h"
+#include "compilation.h"
+#include "batch/batch-compiler.h"
+#include "cache/compilation-cache.h"
+#include "server/compile-server.h"
+
+//
+// Values of long options without a short name
+//
+#define OPTION_CACHE_SIZE		1000
+#define OPTION_CACHE_STATS		1001
+#define OPTION_SERVER			1002
+#define OPTION_CONNECT			1003
+#define OPTION_TIME_REPORT		1004
+#define OPTION_NO_PASS_FUSION	1005
+#define OPTION_CHECK			1006
 
 //
 // getopt_long options
@@ -21,6 +34,20 @@ static struct option long_options[] =
 	{ "output",		required_argument,	NULL,		'o' },
 	{ "verbose",	required_argument,	NULL,		'V' },
 	{ "backend",	required_argument,	NULL,		'b' },
+	{ "unroll",		required_argument,	NULL,		'u' },
+	{ "memfd",		no_argument,		NULL,		'm' },
+	{ "listing",	no_argument,		NULL,		'l' },
+	{ "static",		no_argument,		NULL,		's' },
+	{ "manifest",	required_argument,	NULL,		'M' },
+	{ "jobs",		required_argument,	NULL,		'j' },
+	{ "cache",		required_argument,	NULL,		'c' },
+	{ "cache-size",	required_argument,	NULL,		OPTION_CACHE_SIZE },
+	{ "cache-stats",	no_argument,		NULL,		OPTION_CACHE_STATS },
+	{ "server",		required_argument,	NULL,		OPTION_SERVER },
+	{ "connect",	required_argument,	NULL,		OPTION_CONNECT },
+	{ "time-report",	optional_argument,	NULL,		OPTION_TIME_REPORT },
+	{ "no-pass-fusion",	no_argument,		NULL,		OPTION_NO_PASS_FUSION },
+	{ "check",		no_argument,		NULL,		OPTION_CHECK },
 
 	// End
 	{ NULL,			0,					NULL, 		0 }
@@ -29,11 +56,13 @@ static struct option long_options[] =
 //
 // Program arguments
 //
-static std::string *output_file = nullptr;
-static std::string *input_file = nullptr;
-static std::string *backend_target = nullptr;
-
-unsigned int verbose_flags = 0;
+static CompilationOptions options;
+static std::vector<std::string> input_files;
+static std::vector<std::string> manifest_files;
+static unsigned int jobs = 0;
+static bool cache_stats = false;
+static std::string server_socket;
+static std::string connect_socket;
 
 //
 // Print version
@@ -62,7 +91,10 @@ void print_usage ()
 {
 	print_version ();
 	std::cout << std::endl;
-	std::cout << "Usage: cbasic [OPTIONS]... FILE" << std::endl;
+	std::cout << "Usage: cbasic [OPTIONS]... FILE..." << std::endl;
+	std::cout << std::endl;
+	std::cout << "Each FILE is compiled into FILE.out, unless a single FILE is given along with -o." << std::endl;
+	std::cout << "Several files are compiled in parallel and reported in the order they were given." << std::endl;
 	std::cout << std::endl;
 	std::cout << "Mandatory arguments to long options are mandatory for short options too." << std::endl;
 	std::cout << std::endl;
@@ -77,8 +109,24 @@ void print_usage ()
 	std::cout << "                            4 - print symbol tables after semantic analysis" << std::endl;
 	std::cout << "                            8 - print program after semantic analysis" << std::endl;
 	std::cout << "                           16 - print generated intermediate language program" << std::endl;
+	std::cout << "                           32 - print constant pool statistics of the backend" << std::endl;
 	std::cout << "  -b, --backend=TARGET    specify output target from the following supported:" << std::endl;
 	std::cout << "                            x86 - 32bit x86 family" << std::endl;
+	std::cout << "  -u, --unroll=FACTOR     specify loop unrolling factor (default " << UNROLL_FACTOR_DEFAULT << ", 1 disables unrolling)" << std::endl;
+	std::cout << "  -M, --manifest=FILE     compile the files listed in FILE, one per line" << std::endl;
+	std::cout << "  -j, --jobs=N            compile up to N files at once (default is the number of cores)" << std::endl;
+	std::cout << "  -c, --cache=DIR         reuse executables of identical compilations kept in DIR" << std::endl;
+	std::cout << "                            (default is $CBASIC_CACHE_DIR, no cache if not set)" << std::endl;
+	std::cout << "      --cache-size=MB     bound the cache size (default " << (CACHE_SIZE_DEFAULT >> 20) << ")" << std::endl;
+	std::cout << "      --cache-stats       print cache statistics" << std::endl;
+	std::cout << "      --server=SOCKET     run as a compile server listening on SOCKET, with -j threads" << std::endl;
+	std::cout << "      --connect=SOCKET    compile FILE through the compile server on SOCKET" << std::endl;
+	std::cout << "      --time-report[=FORMAT]" << std::endl;
+	std::cout << "                          report time and memory used by each compilation phase as:" << std::endl;
+	std::cout << "                            text - a table printed after compiling (default)" << std::endl;
+	std::cout << "                            json - a JSON document written to the output file + .time.json" << std::endl;
+	std::cout << "      --check             stop after semantic analysis, without generating code" << std::endl;
+	std::cout << "      --no-pass-fusion    walk the tree once for every semantic analysis pass" << std::endl;
 }
 
 //
@@ -90,7 +138,7 @@ int parse_args (int argc, char **argv)
 	{
 		// get option
 		int option_index = -1;
-		int c = getopt_long (argc, argv, "vho:V:b:", long_options, &option_index);
+		int c = getopt_long (argc, argv, "vho:V:b:u:mlsM:j:c:", long_options, &option_index);
 		if (c == -1)
 		{
 			// Finished
@@ -117,8 +165,8 @@ int parse_args (int argc, char **argv)
 			case 'V':
 				if (optarg != NULL)
 				{
-					verbose_flags = atoi (optarg);
-					if (verbose_flags > VERBOSE_FLAG_MAX)
+					options.verbose_flags = atoi (optarg);
+					if (options.verbose_flags > VERBOSE_FLAG_MAX)
 					{
 						Error::internalError("verbose flags out of bounds");
 						return ER_FAILED;
@@ -134,7 +182,7 @@ int parse_args (int argc, char **argv)
 			case 'b':
 				if (optarg != NULL)
 				{
-					backend_target = new std::string (optarg);
+					options.backend_target = optarg;
 				}
 				else
 				{
@@ -143,6 +191,135 @@ int parse_args (int argc, char **argv)
 				}
 				break;
 
+			case 'u':
+				if (optarg != NULL)
+				{
+					options.unroll_factor = atoi (optarg);
+					if (options.unroll_factor > UNROLL_FACTOR_MAX)
+					{
+						Error::internalError ("unroll factor out of bounds");
+						return ER_FAILED;
+					}
+				}
+				else
+				{
+					Error::internalError ("unroll factor not provided");
+					return ER_FAILED;
+				}
+				break;
+
+			case 'm':
+				options.assembly_in_memory = true;
+				break;
+
+			case 'l':
+				options.listing = true;
+				break;
+
+			case 's':
+				options.static_linking = true;
+				break;
+
+			case 'M':
+				if (optarg != NULL)
+				{
+					manifest_files.push_back (optarg);
+				}
+				else
+				{
+					Error::internalError ("manifest file not provided");
+					return ER_FAILED;
+				}
+				break;
+
+			case 'j':
+				if (optarg != NULL && atoi (optarg) > 0)
+				{
+					jobs = atoi (optarg);
+				}
+				else
+				{
+					Error::internalError ("invalid number of jobs");
+					return ER_FAILED;
+				}
+				break;
+
+			case 'c':
+				if (optarg != NULL)
+				{
+					options.cache_directory = optarg;
+				}
+				else
+				{
+					Error::internalError ("cache directory not provided");
+					return ER_FAILED;
+				}
+				break;
+
+			case OPTION_CACHE_SIZE:
+				if (optarg != NULL && atol (optarg) > 0)
+				{
+					options.cache_size = (unsigned long) atol (optarg) << 20;
+				}
+				else
+				{
+					Error::internalError ("invalid cache size");
+					return ER_FAILED;
+				}
+				break;
+
+			case OPTION_CACHE_STATS:
+				cache_stats = true;
+				break;
+
+			case OPTION_SERVER:
+				if (optarg != NULL)
+				{
+					server_socket = optarg;
+				}
+				else
+				{
+					Error::internalError ("server socket not provided");
+					return ER_FAILED;
+				}
+				break;
+
+			case OPTION_CONNECT:
+				if (optarg != NULL)
+				{
+					connect_socket = optarg;
+				}
+				else
+				{
+					Error::internalError ("server socket not provided");
+					return ER_FAILED;
+				}
+				break;
+
+			case OPTION_TIME_REPORT:
+				if (optarg == NULL || std::string (optarg) == "text")
+				{
+					options.time_report = TIME_REPORT_TEXT;
+				}
+				else if (std::string (optarg) == "json")
+				{
+					options.time_report = TIME_REPORT_JSON;
+				}
+				else
+				{
+					Error::internalError ("invalid time report format '" + std::string (optarg) + "'");
+					return ER_FAILED;
+				}
+				break;
+
+			case OPTION_NO_PASS_FUSION:
+				options.pass_fusion = false;
+				break;
+
+			case OPTION_CHECK:
+				options.check_only = true;
+				break;
+
 			case 'v':
 				print_version ();
 				std::cout << std::endl;
@@ -156,7 +333,7 @@ int parse_args (int argc, char **argv)
 			case 'o':
 				if (optarg != NULL)
 				{
-					output_file = new std::string (optarg);
+					options.output_file = optarg;
 				}
 				else
 				{
@@ -175,24 +352,15 @@ int parse_args (int argc, char **argv)
 		}
 	}
 
-	// Parse filename
-	if (argc == optind + 1)
+	// Parse filenames
+	for (int i = optind; i < argc; i ++)
 	{
-		if (argv[optind - 1] != NULL)
-		{
-			input_file = new std::string (argv[optind]);
-			return NO_ERROR;
-		}
-		else
+		if (argv[i] == NULL)
 		{
 			Error::internalError ("file argument pointer is NULL");
 			return ER_FAILED;
 		}
-	}
-	else if (argc > optind + 1)
-	{
-		Error::internalError ("multiple input files not allowed");
-		return ER_FAILED;
+		input_files.push_back (argv[i]);
 	}
 
 	// All ok
@@ -219,108 +387,94 @@ int main (int argc, char **argv)
 			return ER_FAILED;
 		}
 
-		// Check minimum set of arguments
-		if (input_file == nullptr)
+		// Default cache
+		if (options.cache_directory.empty () && getenv ("CBASIC_CACHE_DIR") != NULL)
 		{
-			Error::error ("input file was not provided");
-			return ER_FAILED;
+			options.cache_directory = getenv ("CBASIC_CACHE_DIR");
+		}
+		if (options.cache_size == 0)
+		{
+			options.cache_size = CACHE_SIZE_DEFAULT;
 		}
 
-		// Default output file if one not provided
-		if (output_file == nullptr)
+		if (cache_stats)
 		{
-			output_file = new std::string (*input_file + ".out");
+			if (options.cache_directory.empty ())
+			{
+				Error::error ("no cache directory given");
+				return ER_FAILED;
+			}
+
+			CompilationCache cache (options.cache_directory, options.cache_size);
+			cache.printStatistics (std::cout);
+			return NO_ERROR;
 		}
 
-		// Default x86 backend if no one was provided
-		if (backend_target == nullptr)
+		// Serve compile requests
+		if (!server_socket.empty ())
 		{
-			backend_target = new std::string ("x86");
+			CompileServer server (server_socket, jobs);
+			if (server.listen () != NO_ERROR)
+			{
+				// Error should have been printed
+				return ER_FAILED;
+			}
+			return server.run ();
 		}
-	}
 
-	//
-	// LEXICAL AND SYNTACTIC ANALYSIS
-	//
-	ParserContext *pc = new ParserContext ();
-	if (pc->parseFile (*input_file) != NO_ERROR)
-	{
-		// Error should have been printed
-		return ER_FAILED;
+		// Check minimum set of arguments
+		if (input_files.empty () && manifest_files.empty ())
+		{
+			Error::error ("input file was not provided");
+			return ER_FAILED;
+		}
 	}
 
-	// VERBOSE code
-	if (VERBOSE_PRINT_AST)
-	{
-		std::cout << std::endl << "[VERBOSE] Abstract Syntax Tree:" << std::endl;
-		pc->printTree (std::cout);
-		std::cout << "[VERBOSE END]" << std::endl << std::endl;
-	}
-	if (VERBOSE_PRINT_PARSED)
+	// Single file, compiled right here
+	if (input_files.size () == 1 && manifest_files.empty ())
 	{
-		std::cout << std::endl << "[VERBOSE] Original program: " << std::endl;
-		pc->printProgram (std::cout);
-		std::cout << "[VERBOSE END]" << std::endl << std::endl;
-	}
+		options.input_file = input_files[0];
 
-	//
-	// SEMANTIC ANALYSIS
-	//
-	if (pc->semanticAnalysis () != NO_ERROR)
-	{
-		// Error should have been printed
-		return ER_FAILED;
-	}
+		// Default output file if one not provided
+		if (options.output_file.empty ())
+		{
+			options.output_file = options.input_file + ".out";
+		}
 
-	// VERBOSE code
-	if (VERBOSE_PRINT_SYMBOLS)
-	{
-		std::cout << std::endl << "[VERBOSE] Symbol table: " << std::endl;
-		SymbolTable::debugPrint ();
-		std::cout << "[VERBOSE END]" << std::endl << std::endl;
-	}
-	if (VERBOSE_PRINT_FINAL)
-	{
-		std::cout << std::endl << "[VERBOSE] Final program: " << std::endl;
-		pc->printProgram (std::cout);
-		std::cout << "[VERBOSE END]" << std::endl << std::endl;
+		if (!connect_socket.empty ())
+		{
+			return CompileServer::compile (connect_socket, options);
+		}
+
+		Compilation compilation (options);
+		return compilation.run ();
 	}
 
-	//
-	// INTERMEDIATE CODE GENERATION
-	//
-	IlProgram *program = pc->generateIlCode ();
-	if (program == nullptr)
+	// Batch of files
+	if (!options.output_file.empty ())
 	{
-		// Error should have been printed
+		Error::error ("output file can't be given for multiple input files");
 		return ER_FAILED;
 	}
-
-	// VERBOSE code
-	if (VERBOSE_PRINT_GENERATED_IL)
+	if (!connect_socket.empty ())
 	{
-		std::cout << std::endl << "[VERBOSE] Generated IL program: " << std::endl;
-		program->debugPrint ();
-		std::cout <<  "[VERBOSE END]" << std::endl << std::endl;
+		Error::error ("only a single file can be compiled through the compile server");
+		return ER_FAILED;
 	}
 
-	//
-	// EXECUTABLE CODE GENERATION
-	//
-	Backend *backend = Backend::getBackend (*backend_target);
-	if (backend == nullptr)
+	BatchCompiler batch (options);
+	for (unsigned int i = 0; i < input_files.size (); i ++)
 	{
-		// Error should have been printed
-		return ER_FAILED;
+		batch.addInput (input_files[i]);
 	}
-
-	// Compile
-	if (backend->compile (program, *output_file) != NO_ERROR)
+	for (unsigned int i = 0; i < manifest_files.size (); i ++)
 	{
-		Error::error ("failed to compile '" + *backend_target + "' target");
-		return ER_FAILED;
+		if (batch.addManifest (manifest_files[i]) != NO_ERROR)
+		{
+			// Error should have been printed
+			return ER_FAILED;
+		}
 	}
 
-	// All ok
-	return 0;
+	return batch.run (jobs);
 }
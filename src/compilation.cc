@@ -0,0 +1,231 @@
+#include "compilation.h"
+#include <iostream>
+#include <fstream>
+#include "error/error.h"
+#include "verbose.h"
+#include "parser/parser-context.h"
+#include "ilang/il-program.h"
+#include "backends/interface/backend.h"
+#include "cache/compilation-cache.h"
+
+Compilation::Compilation (const CompilationOptions &options) : options_ (options)
+{
+	next_temporary_id_ = 0;
+	next_label_id_ = 0;
+	output_ = &std::cout;
+	diagnostics_ = &std::cerr;
+	parser_context_ = nullptr;
+	program_ = nullptr;
+	cache_hit_ = false;
+}
+
+Compilation::~Compilation ()
+{
+	if (program_ != nullptr)
+	{
+		delete program_;
+		program_ = nullptr;
+	}
+
+	if (parser_context_ != nullptr)
+	{
+		delete parser_context_;
+		parser_context_ = nullptr;
+	}
+}
+
+int Compilation::parse ()
+{
+	//
+	// LEXICAL AND SYNTACTIC ANALYSIS
+	//
+	parser_context_ = new ParserContext (this);
+	if (parser_context_->parseFile (options_.input_file) != NO_ERROR)
+	{
+		// Error should have been printed
+		return ER_FAILED;
+	}
+
+	// VERBOSE code
+	if (isVerbose (VERBOSE_FLAG_PRINT_AST))
+	{
+		*output_ << std::endl << "[VERBOSE] Abstract Syntax Tree:" << std::endl;
+		parser_context_->printTree (*output_);
+		*output_ << "[VERBOSE END]" << std::endl << std::endl;
+	}
+	if (isVerbose (VERBOSE_FLAG_PRINT_PARSED))
+	{
+		*output_ << std::endl << "[VERBOSE] Original program: " << std::endl;
+		parser_context_->printProgram (*output_);
+		*output_ << "[VERBOSE END]" << std::endl << std::endl;
+	}
+
+	return NO_ERROR;
+}
+
+int Compilation::analyze ()
+{
+	//
+	// SEMANTIC ANALYSIS
+	//
+	if (parser_context_->semanticAnalysis () != NO_ERROR)
+	{
+		// Error should have been printed
+		return ER_FAILED;
+	}
+
+	// VERBOSE code
+	if (isVerbose (VERBOSE_FLAG_PRINT_SYMBOLS))
+	{
+		*output_ << std::endl << "[VERBOSE] Symbol table: " << std::endl;
+		symbols_.debugPrint (*output_);
+		*output_ << "[VERBOSE END]" << std::endl << std::endl;
+	}
+	if (isVerbose (VERBOSE_FLAG_PRINT_FINAL))
+	{
+		*output_ << std::endl << "[VERBOSE] Final program: " << std::endl;
+		parser_context_->printProgram (*output_);
+		*output_ << "[VERBOSE END]" << std::endl << std::endl;
+	}
+
+	return NO_ERROR;
+}
+
+int Compilation::generate ()
+{
+	//
+	// INTERMEDIATE CODE GENERATION
+	//
+	program_ = parser_context_->generateIlCode ();
+	if (program_ == nullptr)
+	{
+		// Error should have been printed
+		return ER_FAILED;
+	}
+
+	// VERBOSE code
+	if (isVerbose (VERBOSE_FLAG_PRINT_GENERATED_IL))
+	{
+		*output_ << std::endl << "[VERBOSE] Generated IL program: " << std::endl;
+		program_->debugPrint (*output_);
+		*output_ <<  "[VERBOSE END]" << std::endl << std::endl;
+	}
+
+	return NO_ERROR;
+}
+
+int Compilation::compile ()
+{
+	//
+	// EXECUTABLE CODE GENERATION
+	//
+	Backend *backend = Backend::getBackend (options_.backend_target);
+	if (backend == nullptr)
+	{
+		// Error should have been printed
+		return ER_FAILED;
+	}
+
+	int rc = backend->compile (this, program_);
+	delete backend;
+	if (rc != NO_ERROR)
+	{
+		Error::error ("failed to compile '" + options_.backend_target + "' target");
+		return ER_FAILED;
+	}
+
+	return NO_ERROR;
+}
+
+void Compilation::printTimeReport (int ret_code)
+{
+	if (options_.time_report == TIME_REPORT_TEXT)
+	{
+		time_report_.print (*output_);
+	}
+	else if (options_.time_report == TIME_REPORT_JSON)
+	{
+		// Kept out of the output stream, so it can be read by tools
+		std::string report_file = options_.output_file + ".time.json";
+		std::ofstream report (report_file);
+		time_report_.printJson (report, options_.input_file, ret_code);
+		report.close ();
+		if (report.fail ())
+		{
+			Error::error ("cannot write time report '" + report_file + "'");
+		}
+		else
+		{
+			*output_ << "[time report] written to " << report_file << std::endl;
+		}
+	}
+}
+
+int Compilation::run ()
+{
+	// Errors raised on this thread belong to this compilation
+	std::ostream *previous_stream = Error::setStream (diagnostics_);
+	int total_phase = time_report_.begin ("compilation");
+	int phase;
+
+	// An identical earlier compilation may have left its executable in the cache
+	CompilationCache cache (options_.cache_directory, options_.cache_size);
+	CacheKey key;
+	bool cacheable = false;
+	if (useCache ())
+	{
+		phase = time_report_.begin ("cache lookup");
+		cacheable = cache.open () == NO_ERROR && cache.computeKey (options_, key) == NO_ERROR;
+		if (cacheable)
+		{
+			cache_hit_ = cache.lookup (key, options_.output_file);
+			*output_ << "[cache] " << (cache_hit_ ? "hit " : "miss ") << key.hash << std::endl;
+		}
+		time_report_.end (phase);
+	}
+	if (cache_hit_)
+	{
+		time_report_.end (total_phase);
+		printTimeReport (NO_ERROR);
+		Error::setStream (previous_stream);
+		return NO_ERROR;
+	}
+
+	phase = time_report_.begin ("parse");
+	int rc = parse ();
+	time_report_.end (phase);
+	if (rc == NO_ERROR)
+	{
+		phase = time_report_.begin ("semantic analysis");
+		rc = analyze ();
+		time_report_.end (phase);
+	}
+	if (rc == NO_ERROR && !options_.check_only)
+	{
+		phase = time_report_.begin ("IL generation");
+		rc = generate ();
+		time_report_.end (phase);
+	}
+	if (rc == NO_ERROR && !options_.check_only)
+	{
+		phase = time_report_.begin ("backend");
+		rc = compile ();
+		time_report_.end (phase);
+	}
+	if (rc == NO_ERROR && cacheable)
+	{
+		phase = time_report_.begin ("cache store");
+		if (cache.store (key, options_.output_file) != NO_ERROR)
+		{
+			// Not fatal, the executable is there
+			*output_ << "[cache] failed to store " << key.hash << std::endl;
+		}
+		time_report_.end (phase);
+	}
+
+	time_report_.end (total_phase);
+	printTimeReport (rc);
+
+	Error::setStream (previous_stream);
+	return rc;
+}
@@ -0,0 +1,127 @@
+#ifndef COMPILATION_H_
+#define COMPILATION_H_
+
+#include <string>
+#include <ostream>
+#include "optimizations.h"
+#include "symbols/symbol-table.h"
+#include "report/time-report.h"
+
+class ParserContext;
+class IlProgram;
+
+//
+// Options of a compilation
+//
+struct CompilationOptions
+{
+	std::string input_file;
+	std::string output_file;
+	std::string backend_target;
+
+	// Sum of VERBOSE_FLAG_* values
+	unsigned int verbose_flags;
+	// Loop unrolling factor (0 or 1 disables loop unrolling)
+	unsigned int unroll_factor;
+
+	// Keep the assembly and object files in memory instead of writing them to disk
+	bool assembly_in_memory;
+	// Write an assembler listing
+	bool listing;
+	// Produce a static executable, without libc and dynamic linker
+	bool static_linking;
+
+	// Directory of the compilation cache (empty disables the cache) and its size bound
+	std::string cache_directory;
+	unsigned long cache_size;
+
+	// Time report format, one of TIME_REPORT_*
+	unsigned int time_report;
+	// Run the semantic analysis passes that allow it in a single tree walk
+	bool pass_fusion;
+	// Stop after semantic analysis, without generating code
+	bool check_only;
+
+	CompilationOptions ()
+		: backend_target ("x86"), verbose_flags (0), unroll_factor (UNROLL_FACTOR_DEFAULT),
+		  assembly_in_memory (false), listing (false), static_linking (false), cache_size (0),
+		  time_report (TIME_REPORT_NONE), pass_fusion (true), check_only (false) { }
+};
+
+//
+// A single compilation of one source file to one executable
+// Holds all the state of the compiler, so that independent compilations can run in
+// one process, on different threads
+//
+class Compilation
+{
+private:
+	CompilationOptions options_;
+
+	// Symbols of the program
+	SymbolTable symbols_;
+
+	// Counters for naming IL temporaries and labels
+	unsigned int next_temporary_id_;
+	unsigned int next_label_id_;
+
+	// Streams for progress and verbose output, and for diagnostics
+	std::ostream *output_;
+	std::ostream *diagnostics_;
+
+	// Parse tree and generated program
+	ParserContext *parser_context_;
+	IlProgram *program_;
+
+	// The executable was taken from the cache
+	bool cache_hit_;
+
+	// Time and memory used by the stages
+	TimeReport time_report_;
+
+	// Print the time report in the requested format
+	void printTimeReport (int ret_code);
+
+	// Check if the cache may be used; verbose output and listings need a real compilation
+	bool useCache () const { return !options_.cache_directory.empty () && options_.verbose_flags == 0 && !options_.listing && !options_.check_only; }
+
+	// Compilation stages, as called by run ()
+	int parse ();
+	int analyze ();
+	int generate ();
+	int compile ();
+
+public:
+	Compilation (const CompilationOptions &options);
+	~Compilation ();
+
+	// Get options
+	const CompilationOptions &getOptions () const { return options_; }
+
+	// Check if a verbose flag is set
+	bool isVerbose (unsigned int flag) const { return (options_.verbose_flags & flag) != 0; }
+
+	// Get the symbol table
+	SymbolTable *getSymbolTable () { return &symbols_; }
+
+	// Get unique names for IL temporaries and labels
+	std::string newTemporaryName () { return "t" + std::to_string (next_temporary_id_ ++); }
+	std::string newLabelName () { return "label_" + std::to_string (next_label_id_ ++); }
+
+	// Set and get the output and diagnostics streams (std::cout and std::cerr by default)
+	void setOutput (std::ostream &output) { output_ = &output; }
+	void setDiagnostics (std::ostream &diagnostics) { diagnostics_ = &diagnostics; }
+	std::ostream &getOutput () const { return *output_; }
+	std::ostream &getDiagnostics () const { return *diagnostics_; }
+
+	// Check if the executable was taken from the cache
+	bool isCacheHit () const { return cache_hit_; }
+
+	// Get the time report
+	TimeReport *getTimeReport () { return &time_report_; }
+
+	// Run the compilation, from source file to executable
+	int run ();
+};
+
+#endif
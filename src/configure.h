@@ -1,10 +0,0 @@
-#ifndef CONFIGURE_H_IN_
-#define CONFIGURE_H_IN_
-
-//
-// Version
-//
-#define VERSION_MAJOR 0
-#define VERSION_MINOR 1
-
-#endif
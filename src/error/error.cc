@@ -2,9 +2,18 @@
 #include <cassert>
 #include "error.h"
 
+thread_local std::ostream *Error::stream_ = nullptr;
+
+std::ostream *Error::setStream (std::ostream *stream)
+{
+	std::ostream *previous = stream_;
+	stream_ = stream;
+	return previous;
+}
+
 void Error::reportError (const std::string error)
 {
-	std::cerr << error << std::endl;
+	(stream_ != nullptr ? *stream_ : std::cerr) << error << std::endl;
 }
 
 void Error::error (const std::string error)
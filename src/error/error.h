@@ -1,6 +1,7 @@
 #ifndef ERROR_H_
 #define ERROR_H_
 
+#include <ostream>
 #include "parser/nodes/parser-node.h"
 
 //
@@ -11,14 +12,22 @@
 
 //
 // Errors handling routines gathered in a static class
+// Errors go to the diagnostics stream of the calling thread, std::cerr by default
 //
 class Error
 {
 private:
+	// Diagnostics stream of the calling thread
+	static thread_local std::ostream *stream_;
+
 	// Common call point for all error routines
 	static void reportError (const std::string error);
 
 public:
+	// Set the diagnostics stream of the calling thread (nullptr for std::cerr);
+	// returns the previous one
+	static std::ostream *setStream (std::ostream *stream);
+
 	// Report a generic error
 	static void error (const std::string error);
 
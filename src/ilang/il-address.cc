@@ -2,8 +2,6 @@
 #include <cassert>
 #include "error/error.h"
 
-int TemporaryIlAddress::next_id_ = 0;
-
 std::string VariableIlAddress::toString ()
 {
 	return var_->getName ();
@@ -43,12 +41,6 @@ std::string ConstantIlAddress::toString ()
 	}
 }
 
-TemporaryIlAddress::TemporaryIlAddress (BasicType type) : IlAddress (type)
-{
-	name_ = "t" + std::to_string (next_id_);
-	next_id_ ++;
-}
-
 std::string TemporaryIlAddress::toString ()
 {
 	return name_;
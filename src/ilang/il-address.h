@@ -21,9 +21,6 @@ enum IlAddressType
 class IlAddress
 {
 private:
-	// Hack for printf - push a float as a qword
-	bool push_as_qword_;
-
 	// Type
 	BasicType type_;
 
@@ -32,7 +29,7 @@ private:
 
 protected:
 	// Hidden constructor
-	IlAddress (BasicType ty) : type_ (ty), push_as_qword_ (false) { };
+	IlAddress (BasicType ty) : type_ (ty) { };
 
 public:
 	virtual ~IlAddress () { };
@@ -42,10 +39,6 @@ public:
 
 	// Get the type
 	virtual BasicType getType () const { return type_; }
-
-	// Hack continues!
-	bool getPushQword () const { return push_as_qword_; }
-	void setPushQword (bool v) { push_as_qword_ = v; }
 };
 
 //
@@ -107,11 +100,11 @@ private:
 	TemporaryIlAddress () : IlAddress (BT_UNKNOWN) { }
 
 protected:
-	static int next_id_;
 	std::string name_;
 
 public:
-	TemporaryIlAddress (BasicType type);
+	// Temporaries are named by the block that creates them, see IlBlock::newTemporary
+	TemporaryIlAddress (BasicType type, std::string name) : IlAddress (type), name_ (name) { }
 
 	std::string toString ();
 	IlAddressType getAddressType () const { return ILA_TEMPORARY; }
@@ -1,5 +1,5 @@
 #include "il-block.h"
-#include <iostream>
+#include "compilation.h"
 
 IlBlock::~IlBlock ()
 {
@@ -9,11 +9,83 @@ IlBlock::~IlBlock ()
 		// Because list of pointers
 		delete *it;
 	}
+
+	for (std::list<IlAddress *>::iterator it = addresses_.begin ();
+		 it != addresses_.end (); it ++)
+	{
+		delete *it;
+	}
+}
+
+TemporaryIlAddress *IlBlock::newTemporary (BasicType type)
+{
+	TemporaryIlAddress *address = new TemporaryIlAddress (type, compilation_->newTemporaryName ());
+	addresses_.push_back (address);
+	return address;
+}
+
+VariableIlAddress *IlBlock::newVariable (VariableSymbol *symbol)
+{
+	VariableIlAddress *address = new VariableIlAddress (symbol);
+	addresses_.push_back (address);
+	return address;
+}
+
+ConstantIlAddress *IlBlock::newConstant (int value)
+{
+	ConstantIlAddress *address = new ConstantIlAddress (value);
+	addresses_.push_back (address);
+	return address;
+}
+
+ConstantIlAddress *IlBlock::newConstant (float value)
+{
+	ConstantIlAddress *address = new ConstantIlAddress (value);
+	addresses_.push_back (address);
+	return address;
+}
+
+ConstantIlAddress *IlBlock::newConstant (std::string value)
+{
+	ConstantIlAddress *address = new ConstantIlAddress (value);
+	addresses_.push_back (address);
+	return address;
+}
+
+LabelIlInstruction *IlBlock::newLabel ()
+{
+	return new LabelIlInstruction (compilation_->newLabelName ());
 }
 
 void IlBlock::addInstruction (IlInstruction *ins)
 {
 	instructions_.push_back (ins);
+
+	// Concatenations into temporaries allocate their result in the string arena
+	if (ins->getInstructionType () == ILI_ASSIGNMENT)
+	{
+		AssignmentIlInstruction *ai = (AssignmentIlInstruction *) ins;
+		if (ai->getOperator () == ILOP_ADD && ai->getResult ()->getType () == BT_STRING)
+		{
+			string_temporaries_ = true;
+		}
+	}
+	else if (ins->getInstructionType () == ILI_CALL)
+	{
+		if (((CallIlInstruction *) ins)->getFunction () == "_str_concat_n")
+		{
+			string_temporaries_ = true;
+		}
+	}
+}
+
+void IlBlock::endStatement ()
+{
+	if (string_temporaries_)
+	{
+		instructions_.push_back (new CallIlInstruction ("_str_arena_reset", 0));
+		string_temporaries_ = false;
+	}
 }
 
 IlBlockIterator IlBlock::getIterator ()
@@ -21,11 +93,11 @@ IlBlockIterator IlBlock::getIterator ()
 	return std::make_tuple (instructions_.begin(), instructions_.end ());
 }
 
-void IlBlock::debugPrint ()
+void IlBlock::debugPrint (std::ostream &stream)
 {
 	for (std::list<IlInstruction *>::iterator it = instructions_.begin ();
 		 it != instructions_.end (); it ++)
 	{
-		std::cout << (*it)->toString () << std::endl;
+		stream << (*it)->toString () << std::endl;
 	}
 }
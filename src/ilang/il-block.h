@@ -3,35 +3,63 @@
 
 #include "il-instructions.h"
 #include <list>
+#include <ostream>
 #include <tuple>
 
 // Instruction list iterator
 typedef std::list<IlInstruction *>::iterator IlInstructionIterator;
 typedef std::tuple<IlInstructionIterator, IlInstructionIterator> IlBlockIterator;
 
+class Compilation;
+
 //
 // Instruction block
 //
 class IlBlock
 {
 protected:
+	// Compilation the block belongs to
+	Compilation *compilation_;
+
 	// Instruction list
 	std::list<IlInstruction *> instructions_;
 
+	// Addresses created for the instructions; they may be shared between instructions, so
+	// the block owns them
+	std::list<IlAddress *> addresses_;
+
+	// String temporaries were created since the last statement boundary
+	bool string_temporaries_;
+
 public:
-	IlBlock () { };
+	IlBlock (Compilation *compilation) : compilation_ (compilation), string_temporaries_ (false) { };
 	~IlBlock ();
 
+	Compilation *getCompilation () const { return compilation_; }
+
 	int getInstructionCount () const { return instructions_.size (); }
 
+	// Create a temporary or a label, uniquely named within the compilation
+	TemporaryIlAddress *newTemporary (BasicType type);
+	LabelIlInstruction *newLabel ();
+
+	// Create a variable or a constant address, owned by the block
+	VariableIlAddress *newVariable (VariableSymbol *symbol);
+	ConstantIlAddress *newConstant (int value);
+	ConstantIlAddress *newConstant (float value);
+	ConstantIlAddress *newConstant (std::string value);
+
 	// Add instruction at the end of the block
 	void addInstruction (IlInstruction *ins);
 
+	// Mark the end of a statement; releases the string temporaries it created
+	void endStatement ();
+
 	// Get iterator for this instruction block
 	IlBlockIterator getIterator ();
 
 	// Print the block's instrunctions, in order
-	void debugPrint ();
+	void debugPrint (std::ostream &stream);
 };
 
 #endif
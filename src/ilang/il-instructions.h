@@ -97,7 +97,7 @@ public:
 	AssignmentIlInstruction (IlAddress *res, IlAddress *opr1) : result_ (res), operand1_ (opr1), operand2_ (nullptr), operator_ (ILOP_NONE) { };
 	AssignmentIlInstruction (IlAddress *res, IlAddress *opr1, IlOperatorType op) : result_ (res), operand1_ (opr1), operand2_ (nullptr), operator_ (op) { };
 	AssignmentIlInstruction (IlAddress *res, IlAddress *opr1, IlAddress *opr2, IlOperatorType op) : result_ (res), operand1_ (opr1), operand2_ (opr2), operator_ (op) { };
-	~AssignmentIlInstruction ();
+	~AssignmentIlInstruction () { }	// Addresses are owned by the block
 
 	// Instruction string representation
 	std::string toString ();
@@ -120,9 +120,8 @@ class LabelIlInstruction : public IlInstruction
 {
 private:
 	std::string name_;
-	static int last_temp_index_;
 public:
-	LabelIlInstruction ();
+	// Labels are named by the block that creates them, see IlBlock::newLabel
 	LabelIlInstruction (std::string name) : name_ (name) { }
 
 	std::string toString ();
@@ -1,6 +1,6 @@
 #include "il-program.h"
 
-void IlProgram::debugPrint ()
+void IlProgram::debugPrint (std::ostream &stream)
 {
-	main_block_.debugPrint ();
+	main_block_.debugPrint (stream);
 }
@@ -12,11 +12,11 @@ private:
 	IlBlock main_block_;
 
 public:
-	IlProgram () { };
+	IlProgram (Compilation *compilation) : main_block_ (compilation) { };
 
 	IlBlock *getMainBlock () { return &main_block_; }
 
-	void debugPrint ();
+	void debugPrint (std::ostream &stream);
 };
 
 #endif
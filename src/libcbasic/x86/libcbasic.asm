@@ -1,24 +1,138 @@
-global _start
-
 ; String routines
 global _sprint
+global _str_copy
+global _str_concat
+global _str_concat_n
+global _str_concat_assign
+global _str_compare
+global _str_equal
+global _str_arena_reset
+
+; Number formatting routines
+global _fmt_int
+global _fmt_float
+
+; Buffered output routines
+global _out_flush
+global _out_string
+global _out_newline
+global _out_int
+global _out_float
+
+; String layout
+%define STRING_INLINE        4          ; characters (or pointer to them) follow the length dword
+%define STRING_INLINE_MAX    12         ; longer strings keep their characters out of line
+%define STRING_STORAGE       8          ; where out of line characters live:
+%define STRING_STATIC        0          ;  literals, never released
+%define STRING_ARENA         1          ;  string arena, released after the statement
+%define STRING_HEAP          2          ;  reference counted heap block
+%define STRING_ARENA_SIZE    0x100000   ; first arena chunk, room for the string temporaries of most statements
+%define STRING_ARENA_CHUNK   0x100000   ; memory mapped at once when a statement needs more
+%define STRING_ARENA_HEADER  16         ; next chunk and mapped size dwords in front of mapped chunks
+
+; Heap
+%define HEAP_HEADER          8          ; size class and reference count dwords in front of every block
+%define HEAP_REFCOUNT        4          ; reference count, below the characters
+%define HEAP_CLASSES         32
+%define HEAP_CHUNK           0x100000   ; memory mapped at once for new blocks
+
+; Output buffer
+%define OUT_BUFFER_SIZE      65536
+%define OUT_RESERVE          256        ; room needed by a single number or newline append
+
+; Float formatting limits
+%define POW10_BIAS           53    ; _pow10_table[POW10_BIAS] = 10^0
+%define FLOAT_MAX_DIGITS     9     ; significant digits that always round trip a 32bit float
+%define FLOAT_FIXED_MIN_EXP  -5    ; smallest exponent printed without E notation
+%define FLOAT_FIXED_MAX_EXP  9     ; first exponent printed with E notation
+
+;
+; DATA section
+;
+section .data
+  ; "00".."99", two ASCII digits for every value below 100
+  _digit_pairs:
+  db '00010203040506070809'
+  db '10111213141516171819'
+  db '20212223242526272829'
+  db '30313233343536373839'
+  db '40414243444546474849'
+  db '50515253545556575859'
+  db '60616263646566676869'
+  db '70717273747576777879'
+  db '80818283848586878889'
+  db '90919293949596979899'
+
+  ; Powers of ten fitting in 32bits
+  _pow10_u32:
+  dd 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
 
-; Int16 routines
+  ; Powers of ten 10^-53..10^53 in extended precision
+  _pow10_table:
+  dt 1.0e-53, 1.0e-52, 1.0e-51, 1.0e-50
+  dt 1.0e-49, 1.0e-48, 1.0e-47, 1.0e-46
+  dt 1.0e-45, 1.0e-44, 1.0e-43, 1.0e-42
+  dt 1.0e-41, 1.0e-40, 1.0e-39, 1.0e-38
+  dt 1.0e-37, 1.0e-36, 1.0e-35, 1.0e-34
+  dt 1.0e-33, 1.0e-32, 1.0e-31, 1.0e-30
+  dt 1.0e-29, 1.0e-28, 1.0e-27, 1.0e-26
+  dt 1.0e-25, 1.0e-24, 1.0e-23, 1.0e-22
+  dt 1.0e-21, 1.0e-20, 1.0e-19, 1.0e-18
+  dt 1.0e-17, 1.0e-16, 1.0e-15, 1.0e-14
+  dt 1.0e-13, 1.0e-12, 1.0e-11, 1.0e-10
+  dt 1.0e-9, 1.0e-8, 1.0e-7, 1.0e-6
+  dt 1.0e-5, 1.0e-4, 1.0e-3, 1.0e-2
+  dt 1.0e-1, 1.0e0, 1.0e1, 1.0e2
+  dt 1.0e3, 1.0e4, 1.0e5, 1.0e6
+  dt 1.0e7, 1.0e8, 1.0e9, 1.0e10
+  dt 1.0e11, 1.0e12, 1.0e13, 1.0e14
+  dt 1.0e15, 1.0e16, 1.0e17, 1.0e18
+  dt 1.0e19, 1.0e20, 1.0e21, 1.0e22
+  dt 1.0e23, 1.0e24, 1.0e25, 1.0e26
+  dt 1.0e27, 1.0e28, 1.0e29, 1.0e30
+  dt 1.0e31, 1.0e32, 1.0e33, 1.0e34
+  dt 1.0e35, 1.0e36, 1.0e37, 1.0e38
+  dt 1.0e39, 1.0e40, 1.0e41, 1.0e42
+  dt 1.0e43, 1.0e44, 1.0e45, 1.0e46
+  dt 1.0e47, 1.0e48, 1.0e49, 1.0e50
+  dt 1.0e51, 1.0e52, 1.0e53
 
-; Float routines
-global _f2s_scientific
+  ; Next free byte and end of the current string arena chunk, and the chunks mapped
+  ; since the last reset
+  _str_arena_top:
+  dd _str_arena
+  _str_arena_end:
+  dd _str_arena + STRING_ARENA_SIZE
+  _str_arena_chunks:
+  dd 0
+
+  ; Runtime error messages
+  _msg_out_of_memory:
+  db 'out of memory', 0xA
+  _msg_out_of_memory_length equ $ - _msg_out_of_memory
 
 ;
-; BSS and DATA sections
+; BSS section
 ;
 section .bss
-  ; Floating point number printing buffer
-  fsbuffer:  resb 256
+  ; String arena
+  alignb 16
+  _str_arena:
+  resb STRING_ARENA_SIZE
 
-section .data
-  ; debug stuff
-  ftest:     db 0x3D,0x00,0x00,0x00,0x04,0x00,0x00,0x71
-  stest:     db 0x0C,'Ana are mere'
+  ; Unused part of the current heap chunk and free lists
+  _heap_top:
+  resd 1
+  _heap_end:
+  resd 1
+  _heap_free:
+  resd HEAP_CLASSES
+
+  ; Output buffer
+  _out_length:
+  resd 1
+  _out_buffer:
+  resb OUT_BUFFER_SIZE
 
 section .text
 
@@ -26,328 +140,1020 @@ section .text
 ;  STRING OPERATIONS
 ;
 
+; Characters of a string
+; %1 receives the character pointer, %2 holds the descriptor pointer
+%macro STRING_CHARS 2
+  lea %1, [%2+STRING_INLINE]
+  cmp dword [%2], STRING_INLINE_MAX
+  cmova %1, [%2+STRING_INLINE]
+%endmacro
+
 ; Print a CBASIC string
-; Structure of string:
-;   str[0] = length (0..255)
-;   str[1..str[0]] = actual string
-; Param1:  pointer to string (stack)
+; Param1:  pointer to string descriptor (stack)
 ; Returns: always zero
 _sprint:
-  ; Get string address
-  mov ecx, dword [esp+4]
-  ; Get string size
-  mov eax, 0
-  mov al, byte [ecx]
-  cmp eax, 0
+  ; Get string address and size
+  mov eax, dword [esp+4]
+  mov edx, dword [eax]
+  test edx, edx
   jz .exit
+  STRING_CHARS ecx, eax
   ; Kernel write
-  mov edx, eax  ; character count
+  push ebx
   mov eax, 4    ; sys_write
   mov ebx, 1    ; stdout
-  inc ecx       ; pointer+1
   int 0x80
+  pop ebx
 .exit:
   ; All ok
   mov eax, 0
   ret
 
 ;
-; 16BIT INTEGER NUMBER OPERATIONS
+; Internal string routines
+;  Strings are 16 byte descriptors: the length as a dword, followed by up to
+;  STRING_INLINE_MAX characters kept inline, or by a pointer to the characters and
+;  their storage class. Strings are immutable: variables share heap blocks through a
+;  reference count, concatenation results live in the string arena, which the
+;  program resets after each statement using strings.
+;  Parameters are passed in registers.
 ;
 
-; Inline convert a 16bit integer into string
-; Word is in AX
-; String pointer is in ECX; function alters ECX accordingly
-; Function will mess up AX, BX, DX and DI
-_inline_w2s:
-  ; Print sign
-  mov bx, ax
-  and bx, 0x8000
-  jz .print_digits
-  mov bl, '-'
-  mov [ecx], byte bl
-  inc ecx
-  neg ax
-.print_digits:
-  ; Initialize context for digits
-  mov bx, 10000    ; upper range divisor
-  mov di, 0        ; flag for first non-zero encountered
-.loop:
-  mov dx, 0
-  ; ax = ax / bx; dx = ax % bx
-  idiv bx
-  ; check if first non-zero encountered
-  or di, ax
-  jnz .write_digit
-  ; Skip over digit
-  ; bx = bx / 10
-  mov ax, bx
-  mov bx, dx
-  mov dx, 0
-  mov di, 10
-  idiv di
-  mov dx, bx
-  mov bx, ax
-  mov ax, dx
-  mov di, 0
-  cmp bx, 0
-  jnz .loop
-  ; This falls trough if all digits are zero and prints just one zero
-.write_digit:
-  ; Write digit (assume ax < 10)
-  add al, 0x30
-  mov [ecx], byte al
+; Copy a memory block
+; ESI holds source pointer, EDI holds destination pointer, ECX holds byte count
+; Function moves ESI and EDI past the copied bytes and will mess up ECX, XMM0
+_mem_copy:
+  cmp ecx, 16
+  jb .tail
+  movdqu xmm0, [esi]
+  movdqu [edi], xmm0
+  add esi, 16
+  add edi, 16
+  sub ecx, 16
+  jmp _mem_copy
+.tail:
+  rep movsb
+  ret
+
+; Allocate string arena memory, released all at once by _str_arena_reset
+;  Memory is carved from the static first chunk; when a statement needs more, new
+;  chunks are memory mapped and linked until the next reset.
+; ECX holds byte count
+; Returns: pointer in EAX; function will mess up ECX
+_str_arena_alloc:
+  mov eax, [_str_arena_top]
+  add ecx, 15
+  and ecx, -16
+  add ecx, eax
+  jc .grow
+  cmp ecx, [_str_arena_end]
+  ja .grow
+  mov [_str_arena_top], ecx
+  ret
+.grow:
+  ; Map a new chunk, large enough for the block
+  sub ecx, eax
+  push ebx
+  push edx
+  push esi
+  push edi
+  push ebp
+  push ecx
+  add ecx, STRING_ARENA_HEADER
+  jc .out_of_memory
+  mov edx, STRING_ARENA_CHUNK
+  cmp ecx, edx
+  cmovb ecx, edx
+  push ecx
+  mov eax, 192          ; sys_mmap2
+  mov ebx, 0
+  mov edx, 3            ; PROT_READ | PROT_WRITE
+  mov esi, 0x22         ; MAP_PRIVATE | MAP_ANONYMOUS
+  mov edi, -1
+  mov ebp, 0
+  int 0x80
+  pop ecx
+  cmp eax, -4096
+  ja .out_of_memory
+  ; Link the chunk and carve the block from it
+  mov edx, [_str_arena_chunks]
+  mov [eax], edx
+  mov [eax+4], ecx
+  mov [_str_arena_chunks], eax
+  add ecx, eax
+  mov [_str_arena_end], ecx
+  add eax, STRING_ARENA_HEADER
+  pop ecx
+  add ecx, eax
+  mov [_str_arena_top], ecx
+  pop ebp
+  pop edi
+  pop esi
+  pop edx
+  pop ebx
+  ret
+.out_of_memory:
+  mov ecx, _msg_out_of_memory
+  mov edx, _msg_out_of_memory_length
+  jmp _runtime_error
+
+; Release all string arena memory, unmapping the chunks mapped since the last reset
+; Returns: always zero
+_str_arena_reset:
+  mov eax, [_str_arena_chunks]
+  test eax, eax
+  jz .done
+  push ebx
+.next:
+  mov edx, [eax]
+  mov [_str_arena_chunks], edx
+  mov ebx, eax
+  mov ecx, [eax+4]
+  mov eax, 91           ; sys_munmap
+  int 0x80
+  mov eax, [_str_arena_chunks]
+  test eax, eax
+  jnz .next
+  pop ebx
+.done:
+  mov dword [_str_arena_top], _str_arena
+  mov dword [_str_arena_end], _str_arena + STRING_ARENA_SIZE
+  mov eax, 0
+  ret
+
+; Allocate a heap block
+;  Blocks are powers of two (at least 16 bytes) and start with the size class and
+;  the reference count (one), freed blocks are kept on one free list per size class.
+;  New blocks are carved from memory mapped chunks.
+; ECX holds byte count
+; Returns: pointer in EAX; function will mess up ECX, EDX
+_heap_alloc:
+  ; Size class: smallest power of two fitting header and bytes
+  add ecx, HEAP_HEADER - 1
+  or ecx, 15
+  bsr ecx, ecx
   inc ecx
-  ; bx = bx / 10
-  mov ax, bx
-  mov bx, dx
-  mov dx, 0
-  mov di, 10        ; from now on it will always jump to .write_digit
-  idiv di
-  mov dx, bx
-  mov bx, ax
-  mov ax, dx
-  ; Loop
-  cmp bx, 0
-  jnz .loop
+  ; Reuse a freed block
+  mov eax, [_heap_free+ecx*4]
+  test eax, eax
+  jz .new
+  mov edx, [eax]
+  mov [_heap_free+ecx*4], edx
+  jmp .found
+.new:
+  ; Carve the block from the current chunk
+  mov edx, 1
+  shl edx, cl
+  mov eax, [_heap_top]
+  add eax, edx
+  cmp eax, [_heap_end]
+  jbe .carved
+  ; Map a new chunk, large enough for the block
+  push ebx
+  push ecx
+  push esi
+  push edi
+  push ebp
+  mov ecx, HEAP_CHUNK
+  cmp edx, ecx
+  cmova ecx, edx
+  push ecx
+  mov eax, 192          ; sys_mmap2
+  mov ebx, 0
+  mov edx, 3            ; PROT_READ | PROT_WRITE
+  mov esi, 0x22         ; MAP_PRIVATE | MAP_ANONYMOUS
+  mov edi, -1
+  mov ebp, 0
+  int 0x80
+  pop ecx
+  cmp eax, -4096
+  ja .out_of_memory
+  mov [_heap_top], eax
+  add ecx, eax
+  mov [_heap_end], ecx
+  pop ebp
+  pop edi
+  pop esi
+  pop ecx
+  pop ebx
+  jmp .new
+.carved:
+  mov [_heap_top], eax
+  sub eax, edx
+.found:
+  mov [eax], ecx
+  mov dword [eax+HEAP_HEADER-HEAP_REFCOUNT], 1
+  add eax, HEAP_HEADER
   ret
+.out_of_memory:
+  mov ecx, _msg_out_of_memory
+  mov edx, _msg_out_of_memory_length
+  jmp _runtime_error
 
-;
-; FLOATING POINT NUMBERS OPERATIONS
-;
+; Release a heap block
+; EAX holds pointer returned by _heap_alloc
+; Function will mess up EAX, ECX, EDX
+_heap_release:
+  sub eax, HEAP_HEADER
+  mov ecx, [eax]
+  mov edx, [_heap_free+ecx*4]
+  mov [eax], edx
+  mov [_heap_free+ecx*4], eax
+  ret
 
-; Print a CBASIC floating point number
-; Param1:  8byte floating point number (stack)
-; Returns: error code of _f2s
-_fprint:
-   ; Fetch float
-  mov eax, dword [esp+4]
-  mov ebx, dword [esp+8]
-  ; Convert to string
-  push dword fsbuffer
+; Print a message on stderr and exit with an error code
+; ECX holds message pointer
+; EDX holds message length
+_runtime_error:
+  mov eax, 4    ; sys_write
+  mov ebx, 2    ; stderr
+  int 0x80
+  mov eax, 1    ; sys_exit
+  mov ebx, 1
+  int 0x80
+
+; Drop the reference a variable holds on its characters
+; EBX holds descriptor pointer
+; Function will mess up EAX, ECX, EDX
+_str_release:
+  cmp dword [ebx], STRING_INLINE_MAX
+  jbe .done
+  cmp dword [ebx+STRING_STORAGE], STRING_HEAP
+  jne .done
+  mov eax, [ebx+STRING_INLINE]
+  dec dword [eax-HEAP_REFCOUNT]
+  jnz .done
+  call _heap_release
+.done:
+  ret
+
+; Assign a string to a variable
+;  Heap and static characters are shared, only characters in the string arena are
+;  copied into a heap block, reusing the destination block if it is not shared
+; EBX holds destination (variable) pointer
+; ECX holds source pointer
+; Returns: always zero; function will mess up ECX, EDX, XMM0
+_str_copy:
+  push esi
+  push edi
+  mov esi, ecx
+  mov eax, [esi]
+  cmp eax, STRING_INLINE_MAX
+  jbe .assign
+  cmp dword [esi+STRING_STORAGE], STRING_HEAP
+  je .share
+  cmp dword [esi+STRING_STORAGE], STRING_ARENA
+  jne .assign
+  ; Reuse destination block if it has enough room
+  cmp dword [ebx], STRING_INLINE_MAX
+  jbe .allocate
+  cmp dword [ebx+STRING_STORAGE], STRING_HEAP
+  jne .allocate
+  mov edi, [ebx+STRING_INLINE]
+  cmp dword [edi-HEAP_REFCOUNT], 1
+  jne .allocate
+  mov ecx, [edi-HEAP_HEADER]
+  mov edx, 1
+  shl edx, cl
+  sub edx, HEAP_HEADER
+  cmp edx, eax
+  jae .copy
+.allocate:
+  mov ecx, eax
+  call _heap_alloc
+  mov edi, eax
+  call _str_release
+  mov [ebx+STRING_INLINE], edi
+  mov dword [ebx+STRING_STORAGE], STRING_HEAP
+.copy:
+  mov ecx, [esi]
+  mov [ebx], ecx
+  mov esi, [esi+STRING_INLINE]
+  call _mem_copy
+  jmp .done
+.share:
+  ; One more variable references the block (taken first, source may be destination)
+  mov eax, [esi+STRING_INLINE]
+  inc dword [eax-HEAP_REFCOUNT]
+.assign:
+  call _str_release
+  movdqu xmm0, [esi]
+  movdqu [ebx], xmm0
+.done:
+  pop edi
+  pop esi
+  mov eax, 0
+  ret
+
+; Concatenate two strings
+;  Results longer than STRING_INLINE_MAX are placed in the string arena
+; EBX holds destination (temporary) pointer
+; ECX holds str1 pointer
+; EDX holds str2 pointer
+; Returns: always zero; function will mess up ECX, EDX, XMM0
+_str_concat:
+  push esi
+  push edi
+  push ebp
+  mov esi, ecx
+  mov ebp, edx
+  ; Result length and storage
+  mov eax, [esi]
+  add eax, [ebp]
+  mov [ebx], eax
+  lea edi, [ebx+STRING_INLINE]
+  cmp eax, STRING_INLINE_MAX
+  jbe .copy
+  mov ecx, eax
+  call _str_arena_alloc
+  mov edi, eax
+  mov [ebx+STRING_INLINE], edi
+  mov dword [ebx+STRING_STORAGE], STRING_ARENA
+.copy:
+  ; Append str1, then str2
+  mov ecx, [esi]
+  STRING_CHARS eax, esi
+  mov esi, eax
+  call _mem_copy
+  mov ecx, [ebp]
+  STRING_CHARS esi, ebp
+  call _mem_copy
+  pop ebp
+  pop edi
+  pop esi
+  mov eax, 0
+  ret
+
+; Total length of strings
+; EBP points to the string pointers
+; ECX holds string count
+; Returns: length in EAX; function will mess up ECX, EDX
+_str_total_length:
+  mov eax, 0
+  mov edx, ebp
+.next:
+  test ecx, ecx
+  jz .done
+  push ecx
+  mov ecx, [edx]
+  add eax, [ecx]
+  pop ecx
+  add edx, 4
+  dec ecx
+  jmp .next
+.done:
+  ret
+
+; Append the characters of strings
+; EBP points to the string pointers
+; ECX holds string count
+; EDI holds destination pointer; function moves EDI past the last character
+; Function will mess up EAX, ECX, EDX, ESI, EBP, XMM0
+_str_append_n:
+  mov edx, ecx
+.next:
+  test edx, edx
+  jz .done
+  mov eax, [ebp]
+  mov ecx, [eax]
+  STRING_CHARS esi, eax
+  call _mem_copy
+  add ebp, 4
+  dec edx
+  jmp .next
+.done:
+  ret
+
+; Concatenate any number of strings into a temporary, copying each of them once
+;  Results longer than STRING_INLINE_MAX are placed in the string arena
+; Param1: destination (temporary) pointer (stack)
+; Param2: string count (stack)
+; Param3..: string pointers (stack)
+; Returns: always zero
+_str_concat_n:
+  push esi
+  push edi
   push ebx
-  push eax
-  call _f2s
-  add esp, 12
-  cmp eax, 0
-  jnz .end
-  ; Print string
-  push dword fsbuffer
-  call _sprint
-  add esp, 4
+  push ebp
+  ; Result length and storage
+  lea ebp, [esp+28]
+  mov ecx, [esp+24]
+  call _str_total_length
+  mov ebx, [esp+20]
+  mov [ebx], eax
+  lea edi, [ebx+STRING_INLINE]
+  cmp eax, STRING_INLINE_MAX
+  jbe .copy
+  mov ecx, eax
+  call _str_arena_alloc
+  mov edi, eax
+  mov [ebx+STRING_INLINE], edi
+  mov dword [ebx+STRING_STORAGE], STRING_ARENA
+.copy:
+  lea ebp, [esp+28]
+  mov ecx, [esp+24]
+  call _str_append_n
+  pop ebp
+  pop ebx
+  pop edi
+  pop esi
   mov eax, 0
-.end:
   ret
 
-; Print a CBASIC floating point number (scientific format)
-; Param1:  8byte floating point number (stack)
-; Returns: error code of _f2s_scientific
-_fprint_scientific:
-  ; Fetch float
-  mov eax, dword [esp+4]
-  mov ebx, dword [esp+8]
-  ; Convert to string
-  push dword fsbuffer
+; Concatenate any number of strings into a variable, copying each of them once
+;  When the variable is the first string and its heap block is not shared and has
+;  room, the other strings are appended in place. The strings may include the
+;  variable, so its old characters are released last.
+; Param1: destination (variable) pointer (stack)
+; Param2: string count (stack)
+; Param3..: string pointers (stack)
+; Returns: always zero
+_str_concat_assign:
+  push esi
+  push edi
   push ebx
+  push ebp
+  lea ebp, [esp+28]
+  mov ecx, [esp+24]
+  call _str_total_length
+  mov ebx, [esp+20]
+  cmp eax, STRING_INLINE_MAX
+  ja .long
+  ; Short result, built on the stack first
+  sub esp, 16
+  mov [esp], eax
+  lea edi, [esp+STRING_INLINE]
+  lea ebp, [esp+44]
+  mov ecx, [esp+40]
+  call _str_append_n
+  call _str_release
+  movdqu xmm0, [esp]
+  movdqu [ebx], xmm0
+  add esp, 16
+  jmp .done
+.long:
+  ; Destination block must be unshared and have room
+  cmp dword [ebx], STRING_INLINE_MAX
+  jbe .allocate
+  cmp dword [ebx+STRING_STORAGE], STRING_HEAP
+  jne .allocate
+  mov edi, [ebx+STRING_INLINE]
+  cmp dword [edi-HEAP_REFCOUNT], 1
+  jne .allocate
+  mov ecx, [edi-HEAP_HEADER]
+  mov edx, 1
+  shl edx, cl
+  sub edx, HEAP_HEADER
+  cmp edx, eax
+  jb .allocate
+  ; First string must be the destination, the other ones must not use its block
+  mov esi, [ebp]
+  cmp dword [esi], STRING_INLINE_MAX
+  jbe .allocate
+  cmp [esi+STRING_INLINE], edi
+  jne .allocate
+  mov ecx, [esp+24]
+  dec ecx
+  lea edx, [ebp+4]
+.check:
+  test ecx, ecx
+  jz .append
+  mov esi, [edx]
+  cmp dword [esi], STRING_INLINE_MAX
+  jbe .check_next
+  cmp [esi+STRING_INLINE], edi
+  je .allocate
+.check_next:
+  add edx, 4
+  dec ecx
+  jmp .check
+.append:
+  mov esi, [ebp]
+  add edi, [esi]
+  mov [ebx], eax
+  add ebp, 4
+  mov ecx, [esp+24]
+  dec ecx
+  call _str_append_n
+  jmp .done
+.allocate:
+  ; New heap block
   push eax
-  call _f2s_scientific
-  add esp, 12
-  cmp eax, 0
-  jnz .end
-  ; Print string
-  push dword fsbuffer
-  call _sprint
-  add esp, 4
+  mov ecx, eax
+  call _heap_alloc
+  push eax
+  mov edi, eax
+  lea ebp, [esp+36]
+  mov ecx, [esp+32]
+  call _str_append_n
+  call _str_release
+  pop edi
+  pop eax
+  mov [ebx], eax
+  mov [ebx+STRING_INLINE], edi
+  mov dword [ebx+STRING_STORAGE], STRING_HEAP
+.done:
+  pop ebp
+  pop ebx
+  pop edi
+  pop esi
   mov eax, 0
-.end:
   ret
 
-; Convert a CBASIC floating point number to a string
-; Param1:  8byte floating point number (stack)
-; Param2:  address to string buffer (stack)
-; Returns: 0 on success, 1 on failure
-_f2s:
-  ; Clear EAX
-  ; AL = buffer for digits
-  mov eax, 0
-  ; String iterator
-  mov ecx, dword [esp+12]    ; 4 (eip) + 8 (param1)
-  mov [ecx], byte 0          ; initialize size to zero (in case of error)
-  inc ecx                    ; skip size byte
-  ; Float reverse iterator
-  mov edx, esp
-  add edx, 11                ; last byte of param1
-  ; EDI will hold pointer in string to last non-zero digit after first two digits
-  ; Initialize in case of shitstorm
-  mov edi, ecx
+; Compare two strings
+; EBX holds str1 pointer
+; ECX holds str2 pointer
+; Returns: 3 if str1 < str2; 2 if str1 == str2; 1 if str1 > str2
+; Function will mess up EBX, ECX, EDX, XMM0, XMM1
+_str_compare:
+  push esi
+  push edi
+  mov eax, [ebx]
+  mov edx, [ecx]
+  STRING_CHARS esi, ebx
+  STRING_CHARS edi, ecx
+  ; Result if all common characters are equal, decided by length
+  mov ebx, 2
+  mov ecx, 1
+  cmp eax, edx
+  cmova ebx, ecx
+  mov ecx, 3
+  cmovb ebx, ecx
+  cmovb edx, eax             ; EDX = number of common characters
+.blocks:
+  ; Find first differing character, 16 at a time and then the rest
+  cmp edx, 16
+  jb .tail
+  movdqu xmm0, [esi]
+  movdqu xmm1, [edi]
+  pcmpeqb xmm0, xmm1
+  pmovmskb eax, xmm0
+  xor eax, 0xFFFF
+  jnz .found
+  add esi, 16
+  add edi, 16
+  sub edx, 16
+  jmp .blocks
+.found:
+  bsf eax, eax
+  add esi, eax
+  add edi, eax
+  jmp .differ
+.tail:
+  test edx, edx
+  jz .done
+  mov al, byte [esi]
+  cmp al, byte [edi]
+  jne .differ
+  inc esi
+  inc edi
+  dec edx
+  jmp .tail
+.differ:
+  mov al, byte [esi]
+  cmp al, byte [edi]
+  mov ebx, 1
+  mov ecx, 3
+  cmovl ebx, ecx
+.done:
+  mov eax, ebx
+  pop edi
+  pop esi
+  ret
+
+; Test two strings for equality, bails out early on different lengths
+; EBX holds str1 pointer
+; ECX holds str2 pointer
+; Returns: 2 if str1 == str2; 1 otherwise (same encoding as _str_compare)
+; Function will mess up EBX, ECX, EDX, XMM0, XMM1
+_str_equal:
+  mov edx, [ebx]
+  cmp edx, [ecx]
+  jne .different
+  push esi
+  push edi
+  STRING_CHARS esi, ebx
+  STRING_CHARS edi, ecx
+.blocks:
+  ; Compare 16 characters at a time and then the rest
+  cmp edx, 16
+  jb .tail
+  movdqu xmm0, [esi]
+  movdqu xmm1, [edi]
+  pcmpeqb xmm0, xmm1
+  pmovmskb eax, xmm0
+  cmp eax, 0xFFFF
+  jne .not_equal
+  add esi, 16
+  add edi, 16
+  sub edx, 16
+  jmp .blocks
+.tail:
+  test edx, edx
+  jz .equal
+  mov al, byte [esi]
+  cmp al, byte [edi]
+  jne .not_equal
+  inc esi
+  inc edi
+  dec edx
+  jmp .tail
+.equal:
+  pop edi
+  pop esi
+  mov eax, 2
+  ret
+.not_equal:
+  pop edi
+  pop esi
+.different:
+  mov eax, 1
+  ret
+
+;
+; 32BIT INTEGER NUMBER OPERATIONS
+;
+
+; Inline convert an unsigned 32bit integer into decimal digits
+; Integer is in EAX
+; String pointer is in EDI; function moves EDI past the last digit
+; Function will mess up EAX, EBX, ECX and EDX
+_fmt_u32:
+  ; Digit count = t + (value >= 10^t), where t = (bit length * 1233) >> 12
+  ; (value | 1 has the same digit count and a defined bit length for zero)
+  mov edx, eax
+  or edx, 1
+  bsr ecx, edx
+  inc ecx
+  imul ecx, ecx, 1233
+  shr ecx, 12
+  cmp edx, dword [_pow10_u32+ecx*4]
+  sbb ecx, -1
+  ; Write digits backwards, two at a time
+  add edi, ecx
+  mov ebx, edi
+.pairs:
+  cmp eax, 100
+  jb .last
+  mov ecx, eax
+  mov edx, 0x51EB851F        ; EDX = value / 100 = (value * 0x51EB851F) >> 37
+  mul edx
+  shr edx, 5
+  imul eax, edx, 100
+  sub ecx, eax               ; ECX = value % 100
+  mov eax, edx
+  movzx edx, word [_digit_pairs+ecx*2]
+  sub ebx, 2
+  mov word [ebx], dx
+  jmp .pairs
+.last:
+  cmp eax, 10
+  jb .single
+  movzx edx, word [_digit_pairs+eax*2]
+  mov word [ebx-2], dx
+  ret
+.single:
+  add al, '0'
+  mov byte [ebx-1], al
+  ret
+
+; Convert a 32bit integer to decimal
+; Param1:  32bit integer (stack)
+; Param2:  address of output buffer, at least 11 bytes (stack)
+; Returns: number of characters written
+_fmt_int:
+  push ebx
+  push esi
+  push edi
+  mov eax, dword [esp+16]
+  mov edi, dword [esp+20]
+  mov esi, edi
+  ; Print sign
+  test eax, eax
+  jns .digits
+  mov byte [edi], '-'
+  inc edi
+  neg eax                    ; also correct for INT_MIN, as unsigned
+.digits:
+  call _fmt_u32
+  ; Return length
+  mov eax, edi
+  sub eax, esi
+  pop edi
+  pop esi
+  pop ebx
+  ret
+
+;
+; FLOATING POINT NUMBERS OPERATIONS
+;
+
+; Convert a 32bit float to the shortest decimal that reads back as the same float
+; Numbers with an exponent in [FLOAT_FIXED_MIN_EXP, FLOAT_FIXED_MAX_EXP) are printed
+; in fixed notation (12.5, 0.001), all others in E notation (1.5E20, 1E-7)
+; Param1:  32bit float (stack)
+; Param2:  address of output buffer, at least 16 bytes (stack)
+; Returns: number of characters written
+_fmt_float:
+  push ebx
+  push esi
+  push edi
+  push ebp
+  ; Locals:
+  ;   [esp]     qword, decimal significand D
+  ;   [esp+8]   dword, rounded candidate, then significant digit count P
+  ;   [esp+12]  16 bytes, digits of D
+  sub esp, 32
+  mov edi, dword [esp+56]    ; output iterator
+  mov esi, edi               ; output start
   ; Print sign
-  mov al, byte [esp+4]
-  test al, 0x80
-  jz .fetch_exp
-  mov al, '-'
-  mov [ecx], al
+  mov eax, dword [esp+52]
+  test eax, eax
+  jns .absolute
+  mov byte [edi], '-'
+  inc edi
+.absolute:
+  and eax, 0x7FFFFFFF
+  mov dword [esp+52], eax
+  ; Infinity, NaN and zero
+  cmp eax, 0x7F800000
+  je .infinity
+  ja .nan
+  test eax, eax
+  jz .zero
+  ; Estimate decimal exponent K = floor(log10(2) * binary exponent)
+  mov ecx, eax
+  shr ecx, 23
+  sub ecx, 127
+  imul ecx, ecx, 1233
+  sar ecx, 12
+  fld dword [esp+52]         ; ST0 = |value|, kept until digits are found
+  ; Adjust K so that 10^K <= |value| < 10^(K+1)
+.exponent_up:
+  lea eax, [ecx+ecx*4]
+  fld tword [_pow10_table+POW10_BIAS*10+10+eax*2]
+  fcomip st0, st1
+  ja .exponent_down
   inc ecx
-.fetch_exp:
-  and al, 0x7F
-  mov ebx, eax
-  sub ebx, 0x40
+  jmp .exponent_up
+.exponent_down:
+  lea eax, [ecx+ecx*4]
+  fld tword [_pow10_table+POW10_BIAS*10+eax*2]
+  fcomip st0, st1
+  jbe .exponent_done
+  dec ecx
+  jmp .exponent_down
+.exponent_done:
+  mov ebp, ecx               ; EBP = K
+  mov ebx, 1                 ; EBX = P
+  ; Find the smallest P for which the nearest P digit decimal rounds back to value
+.try_digits:
+  ; D = round(|value| * 10^(P-1-K))
+  mov eax, ebx
+  sub eax, ebp
+  lea eax, [eax+eax*4]
+  fld tword [_pow10_table+POW10_BIAS*10-10+eax*2]
+  fmul st0, st1
+  fistp qword [esp]
+  cmp ebx, FLOAT_MAX_DIGITS
+  jae .digits_found
+  ; Check float (D * 10^(K-P+1)) == |value|
+  fild qword [esp]
+  mov eax, ebp
+  sub eax, ebx
+  lea eax, [eax+eax*4]
+  fld tword [_pow10_table+POW10_BIAS*10+10+eax*2]
+  fmulp st1, st0
+  fstp dword [esp+8]
+  mov eax, dword [esp+8]
+  cmp eax, dword [esp+52]
+  je .digits_found
+  inc ebx
+  jmp .try_digits
+.digits_found:
+  fstp st0
+  mov dword [esp+8], ebx
+  ; Convert D to digits
+  mov eax, dword [esp]
+  push edi
+  lea edi, [esp+16]
+  call _fmt_u32
+  mov ecx, edi
+  pop edi
+  lea edx, [esp+12]          ; EDX = digits
+  sub ecx, edx               ; ECX = digit count
+  ; Rounding may have carried into an extra digit (D = 10^P)
+  add ebp, ecx
+  sub ebp, dword [esp+8]
+  ; Drop trailing zeros
+.strip_zeros:
+  cmp ecx, 1
+  jbe .layout
+  cmp byte [edx+ecx-1], '0'
+  jne .layout
+  dec ecx
+  jmp .strip_zeros
+.layout:
+  cmp ebp, FLOAT_FIXED_MIN_EXP
+  jl .scientific
+  cmp ebp, FLOAT_FIXED_MAX_EXP
+  jge .scientific
+  test ebp, ebp
+  js .fraction_only
+  ; Integer part, K+1 digits padded with zeros
+  mov ebx, 0
+.integer_part:
+  mov al, '0'
+  cmp ebx, ecx
+  jae .integer_digit
+  mov al, byte [edx+ebx]
+.integer_digit:
+  mov byte [edi], al
+  inc edi
+  inc ebx
+  cmp ebx, ebp
+  jbe .integer_part
+  ; Fractional part, remaining digits
+  cmp ebx, ecx
+  jae .done
+  mov byte [edi], '.'
+  inc edi
+.fraction_part:
+  mov al, byte [edx+ebx]
+  mov byte [edi], al
+  inc edi
+  inc ebx
+  cmp ebx, ecx
+  jb .fraction_part
+  jmp .done
+.fraction_only:
+  ; 0.[-K-1 zeros][digits]
+  mov byte [edi], '0'
+  mov byte [edi+1], '.'
+  add edi, 2
+  mov ebx, ebp
 .leading_zeros:
-  ; E-? case, print leading zeros
-  test ebx, ebx
-  jns .loop
-  mov al, 0x30
-  mov [ecx], byte al
-  inc ecx
   inc ebx
+  jz .fraction_part
+  mov byte [edi], '0'
+  inc edi
   jmp .leading_zeros
-.loop:
-  ; Fetch byte
+.scientific:
+  ; d[.ddd]E[-]K
   mov al, byte [edx]
-  test ebx, 0x1
-  jz .check_range
-  shr al, 4
-  dec edx
-.check_range:
-  and al, 0xF
-  ; Check 0-9 range
-  cmp al, 9
-  ;jg .error
-  ; Print digit
-  add al, 0x30               ; '0' + al
-  mov [ecx], byte al
-  inc ecx
-  ; Print dot after first digit
-  cmp ebx, 0
-  jnz .fractional_part
-  mov [ecx], byte '.'
-  inc ecx
-  mov edi, ecx
-  jmp .loop_next
-.fractional_part:
-  cmp ebx, 1
-  jz .save_digit_as_nonzero
-  ; If digit is non-zero, save ECX as last true non-zero digit
-  sub al, 0x30
-  jz .loop_next
-.save_digit_as_nonzero:
-  mov edi, ecx
-.loop_next:
-  ; Advance and loop
+  mov byte [edi], al
+  inc edi
+  cmp ecx, 1
+  jbe .exponent
+  mov byte [edi], '.'
+  inc edi
+  mov ebx, 1
+.mantissa:
+  mov al, byte [edx+ebx]
+  mov byte [edi], al
+  inc edi
   inc ebx
-  cmp ebx, 14
-  jnz .loop
-  ; Re-initialize ECX
-  ;mov ecx, edi
-  ; Put string size
-  mov eax, ecx
-  mov ecx, dword [esp+12]
-  sub eax, ecx
-  dec eax
-  mov [ecx], al
-  ; All ok
-  mov eax, 0
+  cmp ebx, ecx
+  jb .mantissa
+.exponent:
+  mov byte [edi], 'E'
+  inc edi
+  mov eax, ebp
+  test eax, eax
+  jns .exponent_digits
+  mov byte [edi], '-'
+  inc edi
+  neg eax
+.exponent_digits:
+  call _fmt_u32
+  jmp .done
+.infinity:
+  mov byte [edi], 'i'
+  mov byte [edi+1], 'n'
+  mov byte [edi+2], 'f'
+  add edi, 3
+  jmp .done
+.nan:
+  mov byte [edi], 'n'
+  mov byte [edi+1], 'a'
+  mov byte [edi+2], 'n'
+  add edi, 3
+  jmp .done
+.zero:
+  mov byte [edi], '0'
+  inc edi
+.done:
+  ; Return length
+  mov eax, edi
+  sub eax, esi
+  add esp, 32
+  pop ebp
+  pop edi
+  pop esi
+  pop ebx
   ret
-.error:
-  ; An error occured
-  mov eax, 1
+
+;
+; BUFFERED OUTPUT
+;  PRINT appends to _out_buffer, which is written to stdout when it fills up and at
+;  program exit. Append routines take their parameter on the stack; all of them
+;  will mess up EAX, EBX, ECX and EDX.
+;
+
+; Write the output buffer to stdout
+; No parameters, no return value
+_out_flush:
+  mov ecx, _out_buffer
+  mov edx, [_out_length]
+.loop:
+  test edx, edx
+  jz .done
+  mov eax, 4    ; sys_write
+  mov ebx, 1    ; stdout
+  int 0x80
+  test eax, eax
+  jle .done
+  add ecx, eax  ; partial write
+  sub edx, eax
+  jmp .loop
+.done:
+  mov dword [_out_length], 0
   ret
 
-; Convert a CBASIC floating point number to a string (scientific format)
-; Param1:  8byte floating point number (stack)
-; Param2:  address to string buffer (stack)
-; Returns: 0 on success, 1 on failure
-_f2s_scientific:
-  ; Clear EAX
-  ; AL = buffer for digits
-  mov eax, 0
-  ; Current digit
-  mov ebx, 0
-  ; String iterator
-  mov ecx, dword [esp+12]    ; 4 (eip) + 8 (param1)
-  mov [ecx], byte 0          ; initialize size to zero (in case of error)
-  inc ecx                    ; skip size byte
-  ; Float reverse iterator
-  mov edx, esp
-  add edx, 11                ; last byte of param1
-  ; EDI will hold pointer in string to last non-zero digit after first two digits
-  ; Initialize in case of shitstorm
-  mov edi, ecx
-  ; Print sign
-  mov al, byte [esp+4]
-  and al, 0x80
-  jz .loop
-  mov al, '-'
-  mov [ecx], al
-  inc ecx
+; Make sure there are at least OUT_RESERVE free bytes in the output buffer
+; Returns: pointer to the first free byte in EBX
+_out_reserve:
+  cmp dword [_out_length], OUT_BUFFER_SIZE - OUT_RESERVE
+  jbe .reserved
+  call _out_flush
+.reserved:
+  mov ebx, [_out_length]
+  add ebx, _out_buffer
+  ret
+
+; Append a string
+;  Strings may be longer than the buffer, so they are copied in chunks, flushing
+;  whenever the buffer fills up
+; Param1: pointer to string descriptor (stack)
+_out_string:
+  mov ecx, [esp+4]
+  mov edx, [ecx]
+  STRING_CHARS eax, ecx
+  push esi
+  push edi
+  mov esi, eax
 .loop:
-  ; Fetch byte
-  mov al, byte [edx]
-  test ebx, 0x1
-  jz .check_range
-  shr al, 4
-  dec edx
-.check_range:
-  and al, 0xF
-  ; Check 0-9 range
-  cmp al, 9
-  jg .error
-  ; Print digit
-  add al, 0x30               ; '0' + al
-  mov [ecx], byte al
-  inc ecx
-  ; Print dot after first digit
-  cmp ebx, 0
-  jnz .fractional_part
-  mov [ecx], byte '.'
-  inc ecx
-  mov edi, ecx
-  jmp .loop_next
-.fractional_part:
-  cmp ebx, 1
-  jz .save_digit_as_nonzero
-  ; If digit is non-zero, save ECX as last true non-zero digit
-  sub al, 0x30
-  jz .loop_next
-.save_digit_as_nonzero:
-  mov edi, ecx
-.loop_next:
-  ; Advance and loop
-  inc ebx
-  cmp ebx, 14
-  jnz .loop
-  ; Re-initialize ECX
-  mov ecx, edi
-  ; Print E
-  mov [ecx], byte 'E'
-  inc ecx
-  ; Extract exponent
-  mov eax, 0
-  mov al, [esp+4]            ; MSB of float
-  and al, 0x7F	             ; ignore sign
-  sub ax, 0x40               ; normalize excess64
-  ; Print exponent
-  call _inline_w2s
-  ; Put string size
-  mov eax, ecx
-  mov ecx, dword [esp+12]
-  sub eax, ecx
-  dec eax
-  mov [ecx], al
-  ; All ok
-  mov eax, 0
+  test edx, edx
+  jz .done
+  mov ecx, OUT_BUFFER_SIZE
+  sub ecx, [_out_length]  ; room left
+  jnz .copy
+  push edx
+  call _out_flush
+  pop edx
+  jmp .loop
+.copy:
+  cmp ecx, edx
+  cmova ecx, edx
+  sub edx, ecx
+  mov edi, [_out_length]
+  add [_out_length], ecx
+  add edi, _out_buffer
+  rep movsb
+  jmp .loop
+.done:
+  pop edi
+  pop esi
   ret
-.error:
-  ; An error occured
-  mov eax, 1
+
+; Append a newline
+; No parameters
+_out_newline:
+  call _out_reserve
+  mov byte [ebx], 0xA
+  inc ebx
+  sub ebx, _out_buffer
+  mov [_out_length], ebx
   ret
 
-_start:
-  ; Wrint float
-  push dword [ftest+4]
-  push dword [ftest]
-  call _fprint
+; Append an integer, in decimal
+; Param1: 32bit integer (stack)
+_out_int:
+  call _out_reserve
+  push ebx
+  push dword [esp+8]
+  call _fmt_int
   add esp, 8
+  add [_out_length], eax
+  ret
 
-  mov ebx, 0
-  mov eax, 1
-  int 0x80
+; Append a floating point number, shortest decimal that reads back as the same float
+; Param1: 32bit float (stack)
+_out_float:
+  call _out_reserve
+  push ebx
+  push dword [esp+8]
+  call _fmt_float
+  add esp, 8
+  add [_out_length], eax
+  ret
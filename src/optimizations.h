@@ -0,0 +1,17 @@
+#ifndef OPTIMIZATIONS_H_
+#define OPTIMIZATIONS_H_
+
+//
+// Loop unrolling limits
+// The factor itself is a compilation option (0 or 1 disables loop unrolling)
+//
+#define UNROLL_FACTOR_DEFAULT					4
+#define UNROLL_FACTOR_MAX						32
+
+// Maximum size (in parser nodes) of a fully unrolled loop body
+#define UNROLL_FULL_MAX_SIZE					256
+
+// Maximum size (in parser nodes) of a partially unrolled loop body
+#define UNROLL_PARTIAL_MAX_SIZE					128
+
+#endif
@@ -35,5 +35,5 @@ void IdentifierNode::setType (BasicType type)
 std::tuple<int, IlAddress *> IdentifierNode::generateIlCode (IlBlock *block)
 {
 	VariableSymbol *vsym = (VariableSymbol *) symbol_;
-	return std::make_tuple (NO_ERROR, new VariableIlAddress (vsym));
+	return std::make_tuple (NO_ERROR, block->newVariable (vsym));
 }
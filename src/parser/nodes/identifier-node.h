@@ -49,8 +49,7 @@ public:
 	ParserNodeType getNodeType () const { return PT_IDENTIFIER; }
 
 	// No children
-	std::list<ParserNode *> getChildren () { return { nullptr }; }
-	std::list<ParserNode **> getChildrenReferences () { return { nullptr }; }
+	ChildSlots getChildSlots () { return ChildSlots (); }
 };
 
 #endif
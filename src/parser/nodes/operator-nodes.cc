@@ -210,7 +210,7 @@ std::tuple<int, IlAddress *> RelationalOperatorNode::generateIlCode (IlBlock *bl
 		break;
 	}
 
-	TemporaryIlAddress *ra = new TemporaryIlAddress (getType ());
+	TemporaryIlAddress *ra = block->newTemporary (getType ());
 	AssignmentIlInstruction *ai =
 		new AssignmentIlInstruction (ra, std::get<1>(ret), std::get<2>(ret), ilop_type);
 	block->addInstruction (ai);
@@ -289,7 +289,7 @@ std::tuple<int, IlAddress *> LogicalOperatorNode::generateIlCode (IlBlock *block
 		break;
 	}
 
-	TemporaryIlAddress *ra = new TemporaryIlAddress (getType ());
+	TemporaryIlAddress *ra = block->newTemporary (getType ());
 	AssignmentIlInstruction *ai =
 		new AssignmentIlInstruction (ra, std::get<1>(ret), std::get<2>(ret), ilop_type);
 	block->addInstruction (ai);
@@ -318,8 +318,93 @@ int PlusOperatorNode::inferType ()
 	}
 }
 
+//
+// Concatenation chains
+//  a$ + b$ + c$ is a tree of binary concatenations; instead of building every
+//  intermediate string, all operands are passed to one runtime call.
+//
+static bool isConcatenationNode (ExpressionNode *node)
+{
+	return node->getNodeType () == PT_OPERATOR
+		&& ((OperatorNode *) node)->getOperatorType () == OT_PLUS
+		&& ((PlusOperatorNode *) node)->isConcatenation ();
+}
+
+unsigned int PlusOperatorNode::getConcatOperandCount () const
+{
+	unsigned int count = 0;
+	for (ExpressionNode *side : { left_, right_ })
+	{
+		count += (isConcatenationNode (side) ? ((PlusOperatorNode *) side)->getConcatOperandCount () : 1);
+	}
+	return count;
+}
+
+int PlusOperatorNode::generateConcatOperands (IlBlock *block, std::vector<IlAddress *> &operands)
+{
+	for (ExpressionNode *side : { left_, right_ })
+	{
+		if (isConcatenationNode (side))
+		{
+			if (((PlusOperatorNode *) side)->generateConcatOperands (block, operands) != NO_ERROR)
+			{
+				return ER_FAILED;
+			}
+			continue;
+		}
+
+		std::tuple<int, IlAddress *> ret = side->generateIlCode (block);
+		if (std::get<0>(ret) != NO_ERROR)
+		{
+			return ER_FAILED;
+		}
+		assert (std::get<1>(ret) != nullptr);
+		operands.push_back (std::get<1>(ret));
+	}
+
+	// All ok
+	return NO_ERROR;
+}
+
+int PlusOperatorNode::generateConcatIlCode (IlBlock *block, IlAddress *dest)
+{
+	assert (isConcatenation ());
+
+	std::vector<IlAddress *> operands;
+	if (generateConcatOperands (block, operands) != NO_ERROR)
+	{
+		return ER_FAILED;
+	}
+
+	// Parameters are pushed last to first: dest, count, operands
+	for (std::vector<IlAddress *>::reverse_iterator it = operands.rbegin (); it != operands.rend (); it ++)
+	{
+		block->addInstruction (new ParamIlInstruction (*it));
+	}
+	block->addInstruction (new ParamIlInstruction (block->newConstant ((int) operands.size ())));
+	block->addInstruction (new ParamIlInstruction (dest));
+
+	// Temporaries are built in the string arena, variables in place
+	std::string function = (dest->getAddressType () == ILA_TEMPORARY ? "_str_concat_n" : "_str_concat_assign");
+	block->addInstruction (new CallIlInstruction (function, 4 * (operands.size () + 2)));
+
+	// All ok
+	return NO_ERROR;
+}
+
 std::tuple<int, IlAddress *> PlusOperatorNode::generateIlCode (IlBlock *block)
 {
+	// Concatenation of more than two strings
+	if (isConcatenation () && getConcatOperandCount () > 2)
+	{
+		TemporaryIlAddress *ra = block->newTemporary (BT_STRING);
+		if (generateConcatIlCode (block, ra) != NO_ERROR)
+		{
+			return std::make_tuple (ER_FAILED, nullptr);
+		}
+		return std::make_tuple (NO_ERROR, ra);
+	}
+
 	std::tuple <int, IlAddress *, IlAddress *> ret = generateLeftRight (block);
 	if (std::get<0>(ret) != NO_ERROR)
 	{
@@ -327,7 +412,7 @@ std::tuple<int, IlAddress *> PlusOperatorNode::generateIlCode (IlBlock *block)
 	}
 	assert (std::get<1>(ret) != nullptr);
 
-	TemporaryIlAddress *ra = new TemporaryIlAddress (getType ());
+	TemporaryIlAddress *ra = block->newTemporary (getType ());
 	AssignmentIlInstruction *ai = nullptr;
 	if (std::get<2>(ret) == nullptr)
 	{
@@ -356,17 +441,17 @@ std::tuple<int, IlAddress *> MinusOperatorNode::generateIlCode (IlBlock *block)
 	}
 	assert (std::get<1>(ret) != nullptr);
 
-	TemporaryIlAddress *ra = new TemporaryIlAddress (getType ());
+	TemporaryIlAddress *ra = block->newTemporary (getType ());
 	AssignmentIlInstruction *ai = nullptr;
 	if (std::get<2>(ret) == nullptr)
 	{
 		if (getType () == BT_INT)
 		{
-			ai = new AssignmentIlInstruction (ra, new ConstantIlAddress ((int) 0), std::get<1>(ret), ILOP_SUB);
+			ai = new AssignmentIlInstruction (ra, block->newConstant ((int) 0), std::get<1>(ret), ILOP_SUB);
 		}
 		else if (getType () == BT_FLOAT)
 		{
-			ai = new AssignmentIlInstruction (ra, new ConstantIlAddress ((float) 0.0f), std::get<1>(ret), ILOP_SUB);
+			ai = new AssignmentIlInstruction (ra, block->newConstant ((float) 0.0f), std::get<1>(ret), ILOP_SUB);
 		}
 		else
 		{
@@ -398,7 +483,7 @@ std::tuple<int, IlAddress *> MultiplicationOperatorNode::generateIlCode (IlBlock
 	assert (std::get<1>(ret) != nullptr);
 	assert (std::get<2>(ret) != nullptr);
 
-	TemporaryIlAddress *ra = new TemporaryIlAddress (getType ());
+	TemporaryIlAddress *ra = block->newTemporary (getType ());
 	AssignmentIlInstruction *ai =
 		new AssignmentIlInstruction (ra, std::get<1>(ret), std::get<2>(ret), ILOP_MUL);
 	block->addInstruction (ai);
@@ -421,7 +506,7 @@ std::tuple<int, IlAddress *> DivisionOperatorNode::generateIlCode (IlBlock *bloc
 	assert (std::get<1>(ret) != nullptr);
 	assert (std::get<2>(ret) != nullptr);
 
-	TemporaryIlAddress *ra = new TemporaryIlAddress (getType ());
+	TemporaryIlAddress *ra = block->newTemporary (getType ());
 	AssignmentIlInstruction *ai =
 		new AssignmentIlInstruction (ra, std::get<1>(ret), std::get<2>(ret), ILOP_DIV);
 	block->addInstruction (ai);
@@ -475,7 +560,7 @@ std::tuple<int, IlAddress *> IntDivisionOperatorNode::generateIlCode (IlBlock *b
 	assert (std::get<1>(ret) != nullptr);
 	assert (std::get<2>(ret) != nullptr);
 
-	TemporaryIlAddress *ra = new TemporaryIlAddress (getType ());
+	TemporaryIlAddress *ra = block->newTemporary (getType ());
 	AssignmentIlInstruction *ai =
 		new AssignmentIlInstruction (ra, std::get<1>(ret), std::get<2>(ret), ILOP_DIV);
 	block->addInstruction (ai);
@@ -575,7 +660,7 @@ std::tuple<int, IlAddress *> ModuloOperatorNode::generateIlCode (IlBlock *block)
 	assert (std::get<1>(ret) != nullptr);
 	assert (std::get<2>(ret) != nullptr);
 
-	TemporaryIlAddress *ra = new TemporaryIlAddress (getType ());
+	TemporaryIlAddress *ra = block->newTemporary (getType ());
 	AssignmentIlInstruction *ai =
 		new AssignmentIlInstruction (ra, std::get<1>(ret), std::get<2>(ret), ILOP_MOD);
 	block->addInstruction (ai);
@@ -673,7 +758,7 @@ std::tuple<int, IlAddress *> CastOperatorNode::generateIlCode (IlBlock *block)
 	}
 	assert (std::get<1>(ret) != nullptr);
 
-	TemporaryIlAddress *ra = new TemporaryIlAddress (getType ());
+	TemporaryIlAddress *ra = block->newTemporary (getType ());
 	AssignmentIlInstruction *ai =
 		new AssignmentIlInstruction (ra, std::get<1>(ret), nullptr, ILOP_CAST);
 	block->addInstruction (ai);
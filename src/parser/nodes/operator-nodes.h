@@ -5,6 +5,7 @@
 #include "expression-node.h"
 #include "error/error.h"
 #include <tuple>
+#include <vector>
 
 //
 // Operator enumeration
@@ -76,8 +77,7 @@ public:
 	std::string print (std::string indent);
 
 	// Return children
-	std::list<ParserNode *> getChildren () { return { left_, right_ }; };
-	std::list<ParserNode **> getChildrenReferences () { return { (ParserNode **) &left_, (ParserNode **) &right_ }; };
+	ChildSlots getChildSlots () { return ChildSlots ((ParserNode **) &left_, (ParserNode **) &right_); };
 };
 
 //
@@ -146,6 +146,17 @@ public:
 	int inferType ();
 	std::tuple<int, IlAddress *> generateIlCode (IlBlock *block);
 	OperatorType getOperatorType () const { return OT_PLUS; }
+
+	// Is this a string concatenation?
+	bool isConcatenation () const { return return_type_ == BT_STRING && right_ != nullptr; }
+
+	// Generate a single concatenation of all operands of a concatenation chain into dest
+	int generateConcatIlCode (IlBlock *block, IlAddress *dest);
+
+private:
+	// Collect the operands of a concatenation chain, in order
+	int generateConcatOperands (IlBlock *block, std::vector<IlAddress *> &operands);
+	unsigned int getConcatOperandCount () const;
 };
 
 //
@@ -10,14 +10,38 @@ ParserNode::ParserNode ()
 
 ParserNode::~ParserNode ()
 {
-	delete next_;
+	// Delete the rest of the list one node at a time; recursing through it would
+	// overflow the stack on long lists
+	ParserNode *node = next_;
+	while (node != nullptr)
+	{
+		ParserNode *next = node->next_;
+		node->next_ = nullptr;
+		delete node;
+		node = next;
+	}
+}
+
+std::string ParserNode::printList (ParserNode *list, std::string indent)
+{
+	std::string text;
+	for (ParserNode *node = list; node != nullptr; node = node->next_)
+	{
+		// Block statements end their text with a newline already
+		if (node != list && text[text.size () - 1] != '\n')
+		{
+			text += "\n";
+		}
+		text += node->print (indent);
+	}
+	return text;
 }
 
 void ParserNode::unlink ()
 {
-	std::list<ParserNode **> refs = getChildrenReferences ();
-	for (std::list<ParserNode **>::iterator it = refs.begin (); it != refs.end (); it ++)
+	ChildSlots children = getChildSlots ();
+	for (unsigned int i = 0; i < children.count; i ++)
 	{
-		*(*it) = NULL;
+		*children.slots[i] = NULL;
 	}
 }
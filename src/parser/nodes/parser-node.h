@@ -2,7 +2,6 @@
 #define PARSER_NODE_H_
 
 #include <string>
-#include <list>
 #include <tuple>
 #include "symbols/basic-types.h"
 #include "parser/location.hh"
@@ -25,6 +24,33 @@ typedef enum
 	PT_STATEMENT			= 100
 } ParserNodeType;
 
+//
+// Most children a parser node has
+//
+#define PARSER_NODE_MAX_CHILDREN	3
+
+class ParserNode;
+
+//
+// Child slots of a parser node
+// Addresses of the node's child pointers, in a fixed-size array returned by value so
+// that going through the children of a node does not allocate. Children may be null.
+//
+struct ChildSlots
+{
+	ParserNode **slots[PARSER_NODE_MAX_CHILDREN];
+	unsigned int count;
+
+	ChildSlots () : count (0) { }
+	ChildSlots (ParserNode **first) : count (1) { slots[0] = first; }
+	ChildSlots (ParserNode **first, ParserNode **second) : count (2) { slots[0] = first; slots[1] = second; }
+	ChildSlots (ParserNode **first, ParserNode **second, ParserNode **third) : count (3)
+		{ slots[0] = first; slots[1] = second; slots[2] = third; }
+
+	// Get a child (may be null)
+	ParserNode *get (unsigned int index) const { return *slots[index]; }
+};
+
 //
 // Generic parser node
 //
@@ -59,17 +85,18 @@ public:
 	// Returns a string representation of the node
 	virtual std::string toString () = 0;
 
-	// Returns a printable representation of the node (and children)
+	// Returns a printable representation of the node (and children, but not the nodes
+	// following it in its list)
 	virtual std::string print (std::string indent) = 0;
 
+	// Returns a printable representation of a list of statements
+	static std::string printList (ParserNode *list, std::string indent);
+
 	// Returns the type of parser node
 	virtual ParserNodeType getNodeType () const = 0;
 
-	// Returns a list of all children
-	virtual std::list<ParserNode *> getChildren () = 0;
-
-	// Returns a list of pointers to all children addresses
-	virtual std::list<ParserNode **> getChildrenReferences () = 0;
+	// Returns the addresses of all children pointers
+	virtual ChildSlots getChildSlots () = 0;
 
 	// Generate intermediate language code
 	// Return tuple: <err_code, result_address>
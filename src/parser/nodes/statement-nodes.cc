@@ -1,7 +1,10 @@
 #include "statement-nodes.h"
 #include "error/error.h"
 #include "ilang/il-instructions.h"
+#include "optimizations.h"
+#include "compilation.h"
 #include <cassert>
+#include <climits>
 #include <list>
 
 AssignmentStatementNode::~AssignmentStatementNode ()
@@ -14,6 +17,28 @@ AssignmentStatementNode::~AssignmentStatementNode ()
 
 std::tuple<int, IlAddress *> AssignmentStatementNode::generateIlCode (IlBlock *block)
 {
+	// Concatenations are built directly into the variable
+	if (expression_->getNodeType () == PT_OPERATOR
+		&& ((OperatorNode *) expression_)->getOperatorType () == OT_PLUS
+		&& ((PlusOperatorNode *) expression_)->isConcatenation ())
+	{
+		std::tuple<int, IlAddress *> iret = identifier_->generateIlCode (block);
+		if (std::get<0>(iret) != NO_ERROR)
+		{
+			return std::make_tuple(ER_FAILED, nullptr);
+		}
+		assert (std::get<1>(iret) != nullptr);
+
+		if (((PlusOperatorNode *) expression_)->generateConcatIlCode (block, std::get<1>(iret)) != NO_ERROR)
+		{
+			return std::make_tuple(ER_FAILED, nullptr);
+		}
+		block->endStatement ();
+
+		// Do NOT return result address, this is a statement!
+		return std::make_tuple(NO_ERROR, nullptr);
+	}
+
 	// Generate code for expression
 	std::tuple<int, IlAddress *> ret = expression_->generateIlCode (block);
 	if (std::get<0>(ret) != NO_ERROR)
@@ -35,6 +60,7 @@ std::tuple<int, IlAddress *> AssignmentStatementNode::generateIlCode (IlBlock *b
 
 	// Push it!
 	block->addInstruction (asg);
+	block->endStatement ();
 
 	// All ok
 	// Do NOT return result address, this is a statement!
@@ -48,12 +74,7 @@ std::string AssignmentStatementNode::toString ()
 
 std::string AssignmentStatementNode::print (std::string indent)
 {
-	std::string this_stmt = "let " + identifier_->print ("") + " = " + expression_->print ("");
-	if (next_ != nullptr)
-	{
-		this_stmt = this_stmt + "\n" + next_->print (indent);
-	}
-	return indent + this_stmt;
+	return indent + "let " + identifier_->print ("") + " = " + expression_->print ("");
 }
 
 AllocationStatementNode::~AllocationStatementNode ()
@@ -61,11 +82,9 @@ AllocationStatementNode::~AllocationStatementNode ()
 	if (identifier_ != nullptr)
 		delete identifier_;
 
-	for (ParserNode *list = dimension_list_, *next = nullptr; list != nullptr; list = next)
-	{
-		next = list->getNext ();
-		delete list;
-	}
+	// Deleting the head of a list deletes the whole list
+	if (dimension_list_ != nullptr)
+		delete dimension_list_;
 }
 
 std::tuple<int, IlAddress *> AllocationStatementNode::generateIlCode (IlBlock *block)
@@ -94,10 +113,6 @@ std::string AllocationStatementNode::print (std::string indent)
 	}
 	this_stmt += ")";
 
-	if (next_ != nullptr)
-	{
-		this_stmt = this_stmt + "\n" + next_->print (indent);
-	}
 	return indent + this_stmt;
 }
 
@@ -106,18 +121,151 @@ WhileStatementNode::~WhileStatementNode ()
 	if (condition_ != nullptr)
 		delete condition_;
 
-	for (ParserNode *list = statements_, *next = nullptr; list != nullptr; list = next)
+	if (statements_ != nullptr)
+		delete statements_;
+
+	if (counter_info_ != nullptr)
+		delete counter_info_;
+}
+
+void WhileStatementNode::setCounterInfo (LoopCounterInfo *info)
+{
+	if (counter_info_ != nullptr && counter_info_ != info)
 	{
-		next = list->getNext ();
-		delete list;
+		delete counter_info_;
 	}
+	counter_info_ = info;
+}
+
+int WhileStatementNode::generateStatementsIlCode (IlBlock *block)
+{
+	ParserNode *st = statements_;
+	while (st != nullptr)
+	{
+		if (st->getNodeType () != PT_STATEMENT)
+		{
+			Error::internalError ("while block contains non-statement");
+			return ER_FAILED;
+		}
+
+		std::tuple<int, IlAddress *> ret = st->generateIlCode (block);
+		if (std::get<0>(ret) != NO_ERROR)
+		{
+			return ER_FAILED;
+		}
+
+		st = st->getNext ();
+	}
+
+	// All ok
+	return NO_ERROR;
+}
+
+int WhileStatementNode::generateUnrolledIlCode (IlBlock *block)
+{
+	LoopCounterInfo *info = counter_info_;
+
+	// Determine comparison operator
+	IlOperatorType ilop_type;
+	switch (info->op)
+	{
+	case OT_LT:
+		ilop_type = ILOP_LT;
+		break;
+
+	case OT_LT_EQ:
+		ilop_type = ILOP_LE;
+		break;
+
+	case OT_GT:
+		ilop_type = ILOP_GT;
+		break;
+
+	case OT_GT_EQ:
+		ilop_type = ILOP_GE;
+		break;
+
+	default:
+		// Overshooting the bound is not allowed for the other operators
+		return NO_ERROR;
+	}
+
+	// The unrolled iterations run only if the last one of them would still satisfy the
+	// loop condition, i.e. counter + (factor - 1) * step <op> bound
+	unsigned int unroll_factor = block->getCompilation ()->getOptions ().unroll_factor;
+	long long bound = (long long) info->bound - (long long) (unroll_factor - 1) * info->step;
+	if (bound < INT_MIN || bound > INT_MAX)
+	{
+		return NO_ERROR;
+	}
+
+	// Generate labels
+	LabelIlInstruction *unrolled_start = block->newLabel ();
+	LabelIlInstruction *unrolled_end = block->newLabel ();
+
+	// Add start label
+	block->addInstruction (unrolled_start);
+
+	// Generate adjusted condition and conditional jump
+	TemporaryIlAddress *cond = block->newTemporary (BT_INT);
+	block->addInstruction (new AssignmentIlInstruction (cond,
+														block->newVariable ((VariableSymbol *) info->counter),
+														block->newConstant ((int) bound),
+														ilop_type));
+	block->addInstruction (new JumpIlInstruction (unrolled_end, cond, true));
+
+	// Generate unrolled statements
+	for (unsigned int i = 0; i < unroll_factor; i ++)
+	{
+		if (generateStatementsIlCode (block) != NO_ERROR)
+		{
+			return ER_FAILED;
+		}
+	}
+
+	// Loop and add end label
+	block->addInstruction (new JumpIlInstruction (unrolled_start));
+	block->addInstruction (unrolled_end);
+
+	// All ok
+	// Remaining iterations will be handled by the regular loop
+	return NO_ERROR;
 }
 
 std::tuple<int, IlAddress *> WhileStatementNode::generateIlCode (IlBlock *block)
 {
+	// Unroll counted loops
+	unsigned int unroll_factor = block->getCompilation ()->getOptions ().unroll_factor;
+	if (counter_info_ != nullptr && unroll_factor > 1)
+	{
+		if (counter_info_->trip_count >= 0
+			&& counter_info_->trip_count * counter_info_->body_size <= UNROLL_FULL_MAX_SIZE)
+		{
+			// Known trip count, fully unroll loop
+			for (int i = 0; i < counter_info_->trip_count; i ++)
+			{
+				if (generateStatementsIlCode (block) != NO_ERROR)
+				{
+					return std::make_tuple(ER_FAILED, nullptr);
+				}
+			}
+
+			// No loop left to generate
+			return std::make_tuple(NO_ERROR, nullptr);
+		}
+		else if (counter_info_->body_size * unroll_factor <= UNROLL_PARTIAL_MAX_SIZE)
+		{
+			// Partially unroll loop, the regular loop below handles the remainder
+			if (generateUnrolledIlCode (block) != NO_ERROR)
+			{
+				return std::make_tuple(ER_FAILED, nullptr);
+			}
+		}
+	}
+
 	// Generate labels
-	LabelIlInstruction *while_start = new LabelIlInstruction ();
-	LabelIlInstruction *while_end = new LabelIlInstruction ();
+	LabelIlInstruction *while_start = block->newLabel ();
+	LabelIlInstruction *while_end = block->newLabel ();
 
 	// Add start label
 	block->addInstruction (while_start);
@@ -131,26 +279,14 @@ std::tuple<int, IlAddress *> WhileStatementNode::generateIlCode (IlBlock *block)
 	assert (std::get<1>(ret) != nullptr);
 
 	// Generate conditional jump
+	block->endStatement ();
 	JumpIlInstruction *cjump = new JumpIlInstruction (while_end, std::get<1>(ret), true);
 	block->addInstruction (cjump);
 
 	// Generate code for inner statements
-	ParserNode *st = statements_;
-	while (st != nullptr)
+	if (generateStatementsIlCode (block) != NO_ERROR)
 	{
-		if (st->getNodeType () != PT_STATEMENT)
-		{
-			Error::internalError ("while block contains non-statement");
-			return std::make_tuple(ER_FAILED, nullptr);
-		}
-
-		ret = st->generateIlCode (block);
-		if (std::get<0>(ret) != NO_ERROR)
-		{
-			return std::make_tuple(ER_FAILED, nullptr);
-		}
-
-		st = st->getNext ();
+		return std::make_tuple(ER_FAILED, nullptr);
 	}
 
 	// Generate unconditional jump
@@ -173,13 +309,9 @@ std::string WhileStatementNode::toString ()
 std::string WhileStatementNode::print (std::string indent)
 {
 	std::string this_stmt = indent + "while " + condition_->print ("") + "\n";
-	this_stmt += statements_->print (indent + "  ") + "\n";
+	this_stmt += printList (statements_, indent + "  ") + "\n";
 	this_stmt += indent + "wend";
 
-	if (next_ != nullptr)
-	{
-		this_stmt = this_stmt + "\n" + next_->print (indent);
-	}
 	return this_stmt;
 }
 
@@ -188,17 +320,11 @@ IfStatementNode::~IfStatementNode ()
 	if (condition_ != nullptr)
 		delete condition_;
 
-	for (ParserNode *list = then_, *next = nullptr; list != nullptr; list = next)
-	{
-		next = list->getNext ();
-		delete list;
-	}
+	if (then_ != nullptr)
+		delete then_;
 
-	for (ParserNode *list = else_, *next = nullptr; list != nullptr; list = next)
-	{
-		next = list->getNext ();
-		delete list;
-	}
+	if (else_ != nullptr)
+		delete else_;
 }
 
 std::tuple<int, IlAddress *> IfStatementNode::generateIlCode (IlBlock *block)
@@ -210,7 +336,7 @@ std::tuple<int, IlAddress *> IfStatementNode::generateIlCode (IlBlock *block)
 	}
 
 	// Create else label
-	LabelIlInstruction *else_start = new LabelIlInstruction ();
+	LabelIlInstruction *else_start = block->newLabel ();
 
 	// Generate condition code
 	std::tuple<int, IlAddress *> ret = condition_->generateIlCode (block);
@@ -221,6 +347,7 @@ std::tuple<int, IlAddress *> IfStatementNode::generateIlCode (IlBlock *block)
 	assert (std::get<1>(ret) != nullptr);
 
 	// Generate conditional jump
+	block->endStatement ();
 	JumpIlInstruction *cjump = new JumpIlInstruction (else_start, std::get<1>(ret), true);
 	block->addInstruction (cjump);
 
@@ -278,29 +405,22 @@ std::string IfStatementNode::toString ()
 std::string IfStatementNode::print (std::string indent)
 {
 	std::string this_stmt = indent + "if " + condition_->print ("") + " then\n";
-	this_stmt += then_->print (indent + "  ") + "\n";
+	this_stmt += printList (then_, indent + "  ") + "\n";
 
 	if (else_ != nullptr)
 	{
 		this_stmt += indent + "else\n";
-		this_stmt += else_->print (indent + "  ") + "\n";
+		this_stmt += printList (else_, indent + "  ") + "\n";
 	}
 	this_stmt += indent + "endif\n";
 
-	if (next_ != nullptr)
-	{
-		this_stmt = this_stmt + next_->print (indent);
-	}
 	return this_stmt;
 }
 
 PrintStatementNode::~PrintStatementNode ()
 {
-	for (ParserNode *list = list_, *next = nullptr; list != nullptr; list = next)
-	{
-		next = list->getNext ();
-		delete list;
-	}
+	if (list_ != nullptr)
+		delete list_;
 }
 
 std::string PrintStatementNode::toString ()
@@ -318,77 +438,50 @@ std::string PrintStatementNode::print (std::string indent)
 		expr = (ExpressionNode *) expr->getNext ();
 	}
 
-	if (next_ != nullptr)
-	{
-		this_stmt = this_stmt + "\n" + next_->print (indent);
-	}
 	return this_stmt;
 }
 
 std::tuple<int, IlAddress *> PrintStatementNode::generateIlCode (IlBlock *block)
 {
-	std::string format_string = "";
-	unsigned int psize = 0;
-
-	// Make a list of all parameters
-	std::list<ExpressionNode *> expr_list;
+	// Append each expression to the output buffer, using the routine specific to its type
 	for (ExpressionNode *e = list_; e != nullptr; e = (ExpressionNode *) e->getNext ())
 	{
-		expr_list.push_back (e);
-		psize += 4;
-
+		std::string function;
 		switch (e->getType ())
 		{
 		case BT_INT:
-			format_string += "%d";
+			function = "_out_int";
 			break;
 
 		case BT_FLOAT:
-			format_string += "%f";
-			psize += 4;
+			function = "_out_float";
 			break;
 
 		case BT_STRING:
-			format_string += "%s";
+			function = "_out_string";
 			break;
 
 		default:
-			break;
+			Error::internalError ("print expression of unknown type");
+			return std::make_tuple(ER_FAILED, nullptr);
 		}
-	}
-	format_string += "\n";
 
-	// Generate parameters from back to front
-	for (std::list<ExpressionNode *>::reverse_iterator it = expr_list.rbegin ();
-		 it != expr_list.rend (); it ++)
-	{
 		// Generate code for expression
-		std::tuple<int, IlAddress *> iret = (*it)->generateIlCode (block);
+		std::tuple<int, IlAddress *> iret = e->generateIlCode (block);
 		if (std::get<0>(iret) != NO_ERROR)
 		{
 			return std::make_tuple(ER_FAILED, nullptr);
 		}
-		IlAddress *addr = std::get<1>(iret);
-		assert (addr != nullptr);
+		assert (std::get<1>(iret) != nullptr);
 
-		// HACK for printf
-		if (addr->getType () == BT_FLOAT)
-		{
-			addr->setPushQword (true);
-		}
-
-		// Insert parameter
-		ParamIlInstruction *param = new ParamIlInstruction (std::get<1> (iret));
-		block->addInstruction (param);
+		// Insert parameter and call
+		block->addInstruction (new ParamIlInstruction (std::get<1> (iret)));
+		block->addInstruction (new CallIlInstruction (function, 4));
 	}
 
-	// Insert format parameter
-	ParamIlInstruction *param = new ParamIlInstruction (new ConstantIlAddress (format_string));
-	block->addInstruction (param);
-
-	// Generate call
-	CallIlInstruction *call = new CallIlInstruction ("printf", psize + 4);
-	block->addInstruction (call);
+	// Terminate line
+	block->addInstruction (new CallIlInstruction ("_out_newline", 0));
+	block->endStatement ();
 
 	// All ok
 	// Do NOT return result address, this is a statement!
@@ -4,6 +4,7 @@
 #include <string>
 #include "parser-node.h"
 #include "identifier-node.h"
+#include "operator-nodes.h"
 
 typedef enum
 {
@@ -62,8 +63,7 @@ public:
 	// Implementations of ParserNode pure virtual functions
 	std::string toString ();
 	std::string print (std::string indent);
-	std::list<ParserNode *> getChildren () { return { identifier_, expression_ }; }
-	std::list<ParserNode **> getChildrenReferences () { return { (ParserNode **) &identifier_, (ParserNode **)&expression_ }; }
+	ChildSlots getChildSlots () { return ChildSlots ((ParserNode **) &identifier_, (ParserNode **) &expression_); }
 };
 
 //
@@ -95,8 +95,33 @@ public:
 	// Implementations of ParserNode pure virtual functions
 	std::string toString ();
 	std::string print (std::string indent);
-	std::list<ParserNode *> getChildren () { return { identifier_, dimension_list_ }; }
-	std::list<ParserNode **> getChildrenReferences () { return { (ParserNode **) &identifier_, &dimension_list_ }; }
+	ChildSlots getChildSlots () { return ChildSlots ((ParserNode **) &identifier_, &dimension_list_); }
+};
+
+//
+// Counted loop description, filled in by loop analysis for loops of the form:
+//   WHILE counter% <op> bound
+//     [...]
+//     LET counter% = counter% + step
+//   WEND
+//
+struct LoopCounterInfo
+{
+	// Counter variable
+	Symbol *counter;
+
+	// Comparison operator, normalized so that the counter is the left operand
+	OperatorType op;
+
+	// Loop bound and counter increment
+	int bound;
+	int step;
+
+	// Number of iterations, or -1 if the initial counter value is not known at compile time
+	int trip_count;
+
+	// Size of loop body, in parser nodes
+	unsigned int body_size;
 };
 
 //
@@ -114,13 +139,26 @@ private:
 	// Code do execute in loop
 	ParserNode *statements_;
 
+	// Counted loop information (nullptr if not a counted loop)
+	LoopCounterInfo *counter_info_;
+
+	// Generate code for one iteration of the loop body
+	int generateStatementsIlCode (IlBlock *block);
+
+	// Generate code for the unrolled part of a counted loop
+	int generateUnrolledIlCode (IlBlock *block);
+
 public:
-	WhileStatementNode (ExpressionNode *cond, ParserNode *stmts) : condition_ (cond), statements_ (stmts) { }
+	WhileStatementNode (ExpressionNode *cond, ParserNode *stmts) : condition_ (cond), statements_ (stmts), counter_info_ (nullptr) { }
 	~WhileStatementNode ();
 
 	ExpressionNode *getCondition () const { return condition_; }
 	ParserNode *getStatements () const { return statements_; }
 
+	// Get and set counted loop information (node takes ownership)
+	LoopCounterInfo *getCounterInfo () const { return counter_info_; }
+	void setCounterInfo (LoopCounterInfo *info);
+
 	// Implementations of StatementNode pure virtual functions
 	StatementType getStatementType () const { return ST_WHILE; }
 	std::tuple<int, IlAddress *> generateIlCode (IlBlock *block);
@@ -128,8 +166,7 @@ public:
 	// Implementations of ParserNode pure virtual functions
 	std::string toString ();
 	std::string print (std::string indent);
-	std::list<ParserNode *> getChildren () { return { condition_, statements_ }; }
-	std::list<ParserNode **> getChildrenReferences () { return { (ParserNode **) &condition_, &statements_ }; }
+	ChildSlots getChildSlots () { return ChildSlots ((ParserNode **) &condition_, &statements_); }
 };
 
 //
@@ -163,8 +200,7 @@ public:
 	// Implementations of ParserNode pure virtual functions
 	std::string toString ();
 	std::string print (std::string indent);
-	std::list<ParserNode *> getChildren () { return { condition_, then_, else_ }; }
-	std::list<ParserNode **> getChildrenReferences () { return { (ParserNode **) &condition_, &then_, &else_ }; }
+	ChildSlots getChildSlots () { return ChildSlots ((ParserNode **) &condition_, &then_, &else_); }
 };
 
 //
@@ -187,8 +223,7 @@ public:
 	// Implementations of ParserNode pure virtual functions
 	std::string toString ();
 	std::string print (std::string indent);
-	std::list<ParserNode *> getChildren () { return { list_ }; }
-	std::list<ParserNode **> getChildrenReferences () { return { (ParserNode **) &list_ }; }
+	ChildSlots getChildSlots () { return ChildSlots ((ParserNode **) &list_); }
 	std::tuple<int, IlAddress *> generateIlCode (IlBlock *block);
 };
 
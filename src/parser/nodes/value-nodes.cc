@@ -30,7 +30,7 @@ std::string StringValueNode::toString ()
 
 std::tuple<int, IlAddress *> StringValueNode::generateIlCode (IlBlock *block)
 {
-	return std::make_tuple (NO_ERROR, new ConstantIlAddress (value_));
+	return std::make_tuple (NO_ERROR, block->newConstant (value_));
 }
 
 std::string IntegerValueNode::toString()
@@ -40,7 +40,7 @@ std::string IntegerValueNode::toString()
 
 std::tuple<int, IlAddress *> IntegerValueNode::generateIlCode (IlBlock *block)
 {
-	return std::make_tuple (NO_ERROR, new ConstantIlAddress (value_));
+	return std::make_tuple (NO_ERROR, block->newConstant (value_));
 }
 
 std::string FloatValueNode::toString ()
@@ -50,5 +50,5 @@ std::string FloatValueNode::toString ()
 
 std::tuple<int, IlAddress *> FloatValueNode::generateIlCode (IlBlock *block)
 {
-	return std::make_tuple (NO_ERROR, new ConstantIlAddress (value_));
+	return std::make_tuple (NO_ERROR, block->newConstant (value_));
 }
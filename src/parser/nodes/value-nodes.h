@@ -29,8 +29,7 @@ public:
 	int inferType () { return NO_ERROR; };
 
 	// No children for value nodes
-	std::list<ParserNode *> getChildren () { return { nullptr }; }
-	std::list<ParserNode **> getChildrenReferences () { return { nullptr }; }
+	ChildSlots getChildSlots () { return ChildSlots (); }
 };
 
 //
@@ -4,6 +4,119 @@
 #include "parser/nodes/operator-nodes.h"
 #include "parser/nodes/value-nodes.h"
 #include "symbols/basic-types.h"
+#include <vector>
+
+//
+// Compare strings the way the runtime does (signed characters, then length)
+//
+static int compare_strings (const std::string &left, const std::string &right)
+{
+	size_t common = (left.length () < right.length () ? left.length () : right.length ());
+	for (size_t i = 0; i < common; i ++)
+	{
+		if (left[i] != right[i])
+		{
+			return ((signed char) left[i] < (signed char) right[i] ? -1 : 1);
+		}
+	}
+	return (left.length () < right.length () ? -1 : (left.length () > right.length () ? 1 : 0));
+}
+
+//
+// String concatenation chains
+//  a$ + "x" + "y" parses as (a$ + "x") + "y"; concatenation is associative, so
+//  adjacent literals of a chain are merged even when they are not siblings
+//
+static bool is_concatenation (ParserNode *node)
+{
+	return node->getNodeType () == PT_OPERATOR
+		&& ((OperatorNode *) node)->getOperatorType () == OT_PLUS
+		&& ((PlusOperatorNode *) node)->isConcatenation ();
+}
+
+// Get operands of a chain; if inner is given, they are detached from the chain and
+// the operators below node are collected in inner
+static void get_concat_operands (ParserNode *node, std::vector<ParserNode *> &operands, std::vector<ParserNode *> *inner)
+{
+	if (!is_concatenation (node))
+	{
+		operands.push_back (node);
+		return;
+	}
+
+	OperatorNode *op = (OperatorNode *) node;
+	for (ParserNode *side : { op->getLeft (), op->getRight () })
+	{
+		get_concat_operands (side, operands, inner);
+		if (inner != nullptr && is_concatenation (side))
+		{
+			inner->push_back (side);
+		}
+	}
+
+	if (inner != nullptr)
+	{
+		op->unlink ();
+	}
+}
+
+static ParserNode *fold_concatenation (ParserNode *node)
+{
+	std::vector<ParserNode *> operands;
+	get_concat_operands (node, operands, nullptr);
+
+	// Anything to merge?
+	bool adjacent = false;
+	for (size_t i = 1; i < operands.size () && !adjacent; i ++)
+	{
+		adjacent = (operands[i - 1]->getNodeType () == PT_VALUE && operands[i]->getNodeType () == PT_VALUE);
+	}
+	if (!adjacent)
+	{
+		return node;
+	}
+
+	// Take operands out of the chain; inner operators are deleted here, the root
+	// by the tree walker
+	std::vector<ParserNode *> inner;
+	operands.clear ();
+	get_concat_operands (node, operands, &inner);
+	for (ParserNode *n : inner)
+	{
+		delete n;
+	}
+
+	// Merge literal runs
+	std::vector<ExpressionNode *> merged;
+	for (ParserNode *operand : operands)
+	{
+		if (operand->getNodeType () == PT_VALUE && !merged.empty () && merged.back ()->getNodeType () == PT_VALUE)
+		{
+			StringValueNode *run = (StringValueNode *) merged.back ();
+			StringValueNode *new_run = new StringValueNode (run->getValue () + ((StringValueNode *) operand)->getValue ());
+			new_run->setLocation (run->getLocation ());
+			delete run;
+			delete operand;
+			merged.back () = new_run;
+		}
+		else
+		{
+			merged.push_back ((ExpressionNode *) operand);
+		}
+	}
+
+	// Rebuild chain
+	ExpressionNode *chain = merged[0];
+	for (size_t i = 1; i < merged.size (); i ++)
+	{
+		PlusOperatorNode *plus = new PlusOperatorNode (chain, merged[i]);
+		plus->setType (BT_STRING);
+		plus->setLocation (node->getLocation ());
+		chain = plus;
+	}
+
+	return chain;
+}
 
 ParserNode *fold_constants (ParserNode *node, struct TreeWalkContext *context)
 {
@@ -439,7 +552,7 @@ ParserNode *fold_constants (ParserNode *node, struct TreeWalkContext *context)
 						new_val = new IntegerValueNode (f_left > f_right ? -1 : 0);
 						break;
 					case BT_STRING:
-						new_val = new IntegerValueNode (s_left.compare (s_right) > 0 ? -1 : 0);
+						new_val = new IntegerValueNode (compare_strings (s_left, s_right) > 0 ? -1 : 0);
 						break;
 					default:
 						break;
@@ -456,7 +569,7 @@ ParserNode *fold_constants (ParserNode *node, struct TreeWalkContext *context)
 						new_val = new IntegerValueNode (f_left < f_right ? -1 : 0);
 						break;
 					case BT_STRING:
-						new_val = new IntegerValueNode (s_left.compare (s_right) < 0 ? -1 : 0);
+						new_val = new IntegerValueNode (compare_strings (s_left, s_right) < 0 ? -1 : 0);
 						break;
 					default:
 						break;
@@ -473,7 +586,7 @@ ParserNode *fold_constants (ParserNode *node, struct TreeWalkContext *context)
 						new_val = new IntegerValueNode (f_left >= f_right ? -1 : 0);
 						break;
 					case BT_STRING:
-						new_val = new IntegerValueNode (s_left.compare (s_right) >= 0 ? -1 : 0);
+						new_val = new IntegerValueNode (compare_strings (s_left, s_right) >= 0 ? -1 : 0);
 						break;
 					default:
 						break;
@@ -490,7 +603,7 @@ ParserNode *fold_constants (ParserNode *node, struct TreeWalkContext *context)
 						new_val = new IntegerValueNode (f_left <= f_right ? -1 : 0);
 						break;
 					case BT_STRING:
-						new_val = new IntegerValueNode (s_left.compare (s_right) <= 0 ? -1 : 0);
+						new_val = new IntegerValueNode (compare_strings (s_left, s_right) <= 0 ? -1 : 0);
 						break;
 					default:
 						break;
@@ -507,7 +620,7 @@ ParserNode *fold_constants (ParserNode *node, struct TreeWalkContext *context)
 						new_val = new IntegerValueNode (f_left == f_right ? -1 : 0);
 						break;
 					case BT_STRING:
-						new_val = new IntegerValueNode (s_left.compare (s_right) == 0 ? -1 : 0);
+						new_val = new IntegerValueNode (compare_strings (s_left, s_right) == 0 ? -1 : 0);
 						break;
 					default:
 						break;
@@ -524,7 +637,7 @@ ParserNode *fold_constants (ParserNode *node, struct TreeWalkContext *context)
 						new_val = new IntegerValueNode (f_left != f_right ? -1 : 0);
 						break;
 					case BT_STRING:
-						new_val = new IntegerValueNode (s_left.compare (s_right) != 0 ? -1 : 0);
+						new_val = new IntegerValueNode (compare_strings (s_left, s_right) != 0 ? -1 : 0);
 						break;
 					default:
 						break;
@@ -623,5 +736,13 @@ ParserNode *fold_constants (ParserNode *node, struct TreeWalkContext *context)
 			}
 		}
 
+	//
+	// Fold literals in string concatenation chains
+	//
+	if (is_concatenation (node))
+	{
+		return fold_concatenation (node);
+	}
+
 	return node;
 }
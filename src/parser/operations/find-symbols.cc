@@ -2,6 +2,7 @@
 #include "symbols/symbol-table.h"
 #include "parser/nodes/parser-node.h"
 #include "parser/nodes/statement-nodes.h"
+#include "compilation.h"
 
 ParserNode *find_symbols (ParserNode *node, struct TreeWalkContext *context)
 {
@@ -13,15 +14,16 @@ ParserNode *find_symbols (ParserNode *node, struct TreeWalkContext *context)
 		if (st->getStatementType () == ST_ASSIGNMENT)
 		{
 			IdentifierNode *id = ((AssignmentStatementNode *) st)->getIdentifier ();
-			Symbol *sym = SymbolTable::getSymbol (id->getName ());
+			SymbolTable *symbols = context->compilation->getSymbolTable ();
+			Symbol *sym = symbols->getSymbol (id->getName ());
 			if (sym != nullptr && (sym->getSymbolType () != SY_VARIABLE || ((VariableSymbol *) sym)->getType () != id->getType ()))
 			{
 				Error::semanticError ("symbol '" + id->getName () + "' already declared with different type in the same scope", node);
 				context->ret_code = ER_FAILED;
 			}
-			else
+			else if (sym == nullptr)
 			{
-				SymbolTable::addSymbol (new VariableSymbol (id->getName (), "", id->getType ()));
+				symbols->addSymbol (new VariableSymbol (id->getName (), "", id->getType ()));
 			}
 		}
 
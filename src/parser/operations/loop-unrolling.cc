@@ -0,0 +1,301 @@
+#include "loop-unrolling.h"
+#include <climits>
+#include "optimizations.h"
+#include "parser/nodes/statement-nodes.h"
+#include "parser/nodes/operator-nodes.h"
+#include "parser/nodes/value-nodes.h"
+#include "parser/nodes/identifier-node.h"
+
+//
+// Return symbol of node if it's an INT identifier, nullptr otherwise
+//
+static Symbol *get_counter_symbol (ParserNode *node)
+{
+	if (node == nullptr || node->getNodeType () != PT_IDENTIFIER)
+	{
+		return nullptr;
+	}
+
+	IdentifierNode *id = (IdentifierNode *) node;
+	return (id->getType () == BT_INT ? id->getSymbol () : nullptr);
+}
+
+//
+// Mirror a relational operator (a op b <=> b op' a)
+//
+static OperatorType mirror_operator (OperatorType op)
+{
+	switch (op)
+	{
+	case OT_LT:
+		return OT_GT;
+	case OT_GT:
+		return OT_LT;
+	case OT_LT_EQ:
+		return OT_GT_EQ;
+	case OT_GT_EQ:
+		return OT_LT_EQ;
+	default:
+		return op;
+	}
+}
+
+//
+// Evaluate loop condition for a given counter value
+//
+static bool evaluate_condition (OperatorType op, long long counter, long long bound)
+{
+	switch (op)
+	{
+	case OT_LT:
+		return counter < bound;
+	case OT_LT_EQ:
+		return counter <= bound;
+	case OT_GT:
+		return counter > bound;
+	case OT_GT_EQ:
+		return counter >= bound;
+	case OT_NOT_EQUAL:
+		return counter != bound;
+	default:
+		return false;
+	}
+}
+
+//
+// Check that "expr" is "counter + step", "step + counter" or "counter - step" and extract step
+//
+static bool get_counter_step (ExpressionNode *expr, Symbol *counter, int *step)
+{
+	if (expr->getNodeType () != PT_OPERATOR)
+	{
+		return false;
+	}
+
+	OperatorNode *op = (OperatorNode *) expr;
+	ExpressionNode *left = op->getLeft ();
+	ExpressionNode *right = op->getRight ();
+	if (right == nullptr)
+	{
+		return false;
+	}
+
+	if (op->getOperatorType () == OT_PLUS)
+	{
+		if (get_counter_symbol (left) == counter && right->getNodeType () == PT_VALUE && right->getType () == BT_INT)
+		{
+			*step = ((IntegerValueNode *) right)->getValue ();
+			return true;
+		}
+		if (get_counter_symbol (right) == counter && left->getNodeType () == PT_VALUE && left->getType () == BT_INT)
+		{
+			*step = ((IntegerValueNode *) left)->getValue ();
+			return true;
+		}
+	}
+	else if (op->getOperatorType () == OT_MINUS)
+	{
+		if (get_counter_symbol (left) == counter && right->getNodeType () == PT_VALUE && right->getType () == BT_INT
+			&& ((IntegerValueNode *) right)->getValue () != INT_MIN)
+		{
+			*step = -((IntegerValueNode *) right)->getValue ();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//
+// Compute size of a node list (including children) and check that no statement
+// other than "allowed" assigns the counter
+//
+static bool check_loop_body (ParserNode *list, Symbol *counter, ParserNode *allowed, unsigned int *size)
+{
+	for (ParserNode *node = list; node != nullptr; node = node->getNext ())
+	{
+		(*size) ++;
+
+		if (node->getNodeType () == PT_STATEMENT
+			&& ((StatementNode *) node)->getStatementType () == ST_ASSIGNMENT
+			&& node != allowed)
+		{
+			AssignmentStatementNode *asn = (AssignmentStatementNode *) node;
+			if (asn->getIdentifier ()->getSymbol () == counter)
+			{
+				return false;
+			}
+		}
+
+		ChildSlots children = node->getChildSlots ();
+		for (unsigned int i = 0; i < children.count; i ++)
+		{
+			if (!check_loop_body (children.get (i), counter, allowed, size))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+//
+// Detect counter pattern in a WHILE loop
+//
+static LoopCounterInfo *analyze_while (WhileStatementNode *wh)
+{
+	// Condition must be "counter <op> literal" or "literal <op> counter"
+	ExpressionNode *cond = wh->getCondition ();
+	if (cond->getNodeType () != PT_OPERATOR)
+	{
+		return nullptr;
+	}
+
+	OperatorNode *op = (OperatorNode *) cond;
+	OperatorType op_type = op->getOperatorType ();
+	if (op_type != OT_LT && op_type != OT_LT_EQ && op_type != OT_GT
+		&& op_type != OT_GT_EQ && op_type != OT_NOT_EQUAL)
+	{
+		return nullptr;
+	}
+
+	Symbol *counter = nullptr;
+	ExpressionNode *bound = nullptr;
+	if ((counter = get_counter_symbol (op->getLeft ())) != nullptr)
+	{
+		bound = op->getRight ();
+	}
+	else if ((counter = get_counter_symbol (op->getRight ())) != nullptr)
+	{
+		bound = op->getLeft ();
+		op_type = mirror_operator (op_type);
+	}
+	else
+	{
+		return nullptr;
+	}
+
+	if (bound->getNodeType () != PT_VALUE || bound->getType () != BT_INT)
+	{
+		return nullptr;
+	}
+
+	// Last statement of body must be the counter update
+	ParserNode *last = wh->getStatements ();
+	if (last == nullptr)
+	{
+		return nullptr;
+	}
+	while (last->getNext () != nullptr)
+	{
+		last = last->getNext ();
+	}
+
+	if (last->getNodeType () != PT_STATEMENT
+		|| ((StatementNode *) last)->getStatementType () != ST_ASSIGNMENT)
+	{
+		return nullptr;
+	}
+
+	AssignmentStatementNode *update = (AssignmentStatementNode *) last;
+	int step = 0;
+	if (update->getIdentifier ()->getSymbol () != counter
+		|| !get_counter_step (update->getExpression (), counter, &step)
+		|| step == 0)
+	{
+		return nullptr;
+	}
+
+	// Counter must be monotonic towards the bound
+	if (((op_type == OT_LT || op_type == OT_LT_EQ) && step < 0)
+		|| ((op_type == OT_GT || op_type == OT_GT_EQ) && step > 0))
+	{
+		return nullptr;
+	}
+
+	// No other statement may modify the counter
+	unsigned int size = 0;
+	if (!check_loop_body (wh->getStatements (), counter, update, &size))
+	{
+		return nullptr;
+	}
+
+	// Looks like a counted loop
+	LoopCounterInfo *info = new LoopCounterInfo ();
+	info->counter = counter;
+	info->op = op_type;
+	info->bound = ((IntegerValueNode *) bound)->getValue ();
+	info->step = step;
+	info->trip_count = -1;
+	info->body_size = size;
+	return info;
+}
+
+//
+// Compute trip count of a counted loop, given the initial counter value
+// Returns -1 if the loop runs for too long to be fully unrolled
+//
+static int compute_trip_count (LoopCounterInfo *info, int start)
+{
+	long long counter = start;
+	int trip_count = 0;
+
+	while (evaluate_condition (info->op, counter, info->bound))
+	{
+		if (trip_count >= UNROLL_FULL_MAX_SIZE)
+		{
+			return -1;
+		}
+
+		counter += info->step;
+		trip_count ++;
+
+		// Counter would overflow at runtime, leave the loop alone
+		if (counter < INT_MIN || counter > INT_MAX)
+		{
+			return -1;
+		}
+	}
+
+	return trip_count;
+}
+
+ParserNode *find_counted_loops (ParserNode *node, struct TreeWalkContext *)
+{
+	if (node->getNodeType () != PT_STATEMENT)
+	{
+		return node;
+	}
+
+	StatementNode *st = (StatementNode *) node;
+
+	// Annotate WHILE loops
+	if (st->getStatementType () == ST_WHILE)
+	{
+		WhileStatementNode *wh = (WhileStatementNode *) node;
+		wh->setCounterInfo (analyze_while (wh));
+	}
+
+	// Literal counter assignment right before a counted loop gives us the trip count
+	// NOTE: the walk visits the rest of the list before the node itself, so the loop is already annotated.
+	if (st->getStatementType () == ST_ASSIGNMENT
+		&& node->getNext () != nullptr
+		&& node->getNext ()->getNodeType () == PT_STATEMENT
+		&& ((StatementNode *) node->getNext ())->getStatementType () == ST_WHILE)
+	{
+		AssignmentStatementNode *asn = (AssignmentStatementNode *) node;
+		LoopCounterInfo *info = ((WhileStatementNode *) node->getNext ())->getCounterInfo ();
+
+		if (info != nullptr
+			&& asn->getIdentifier ()->getSymbol () == info->counter
+			&& asn->getExpression ()->getNodeType () == PT_VALUE
+			&& asn->getExpression ()->getType () == BT_INT)
+		{
+			info->trip_count = compute_trip_count (info, ((IntegerValueNode *) asn->getExpression ())->getValue ());
+		}
+	}
+
+	// This is an annotation function, return same node
+	return node;
+}
@@ -0,0 +1,12 @@
+#ifndef LOOP_UNROLLING_H_
+#define LOOP_UNROLLING_H_
+
+#include "parser/tree-walker.h"
+#include "parser/nodes/parser-node.h"
+
+//
+// Callback function for tree walk to find counted loops and annotate them for unrolling
+//
+extern ParserNode *find_counted_loops (ParserNode *node, struct TreeWalkContext *context);
+
+#endif
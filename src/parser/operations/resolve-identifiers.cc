@@ -2,6 +2,7 @@
 #include "symbols/symbol-table.h"
 #include "parser/nodes/identifier-node.h"
 #include "error/error.h"
+#include "compilation.h"
 
 ParserNode *resolve_identifiers (ParserNode *node, struct TreeWalkContext *context)
 {
@@ -12,7 +13,7 @@ ParserNode *resolve_identifiers (ParserNode *node, struct TreeWalkContext *conte
 		IdentifierNode *in = (IdentifierNode *)node;
 
 		// Search in table
-		Symbol *sym = SymbolTable::getSymbol (in->getName ());
+		Symbol *sym = context->compilation->getSymbolTable ()->getSymbol (in->getName ());
 
 		// Check existence
 		if (sym == nullptr)
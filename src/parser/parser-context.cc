@@ -1,4 +1,5 @@
 #include <fstream>
+#include <stack>
 #include "parser-context.h"
 
 #include "nodes/statement-nodes.h"
@@ -7,11 +8,14 @@
 #include "parser/operations/find-symbols.h"
 #include "parser/operations/resolve-identifiers.h"
 #include "parser/operations/constant-folding.h"
+#include "parser/operations/loop-unrolling.h"
+#include "pass-manager.h"
 #include "symbols/symbol-table.h"
-#include "tree-walker.h"
+#include "compilation.h"
 
-ParserContext::ParserContext ()
+ParserContext::ParserContext (Compilation *compilation)
 {
+	compilation_ = compilation;
 	lexer_ = nullptr;
 	parser_ = nullptr;
 	root_node_ = nullptr;
@@ -30,6 +34,12 @@ ParserContext::~ParserContext ()
 		delete parser_;
 		parser_ = nullptr;
 	}
+
+	if (root_node_ != nullptr)
+	{
+		delete root_node_;
+		root_node_ = nullptr;
+	}
 }
 
 int ParserContext::parseFile (std::string &filename)
@@ -69,80 +79,64 @@ int ParserContext::parseFile (std::string &filename)
 
 int ParserContext::semanticAnalysis ()
 {
-	WalkTuple ret;
-
-	// Find symbols
-	ret = TreeWalker::leafToRoot (root_node_, find_symbols, false);
-	root_node_ = std::get<1> (ret);
-	if (std::get<0> (ret) != NO_ERROR)
-	{
-		return ER_FAILED;
-	}
-
-	// Resolve identifiers
-	ret = TreeWalker::leafToRoot (root_node_, resolve_identifiers, false);
-	root_node_ = std::get<1> (ret);
-	if (std::get<0> (ret) != NO_ERROR)
-	{
-		return ER_FAILED;
-	}
-
-	// Check types
-	ret = TreeWalker::leafToRoot (root_node_, check_types, false);
-	root_node_ = std::get<1> (ret);
-	if (std::get<0> (ret) != NO_ERROR)
-	{
-		return ER_FAILED;
-	}
-
-	// Fold constants
-	ret = TreeWalker::leafToRoot (root_node_, fold_constants, false);
-	root_node_ = std::get<1> (ret);
-	if (std::get<0> (ret) != NO_ERROR)
-	{
-		return ER_FAILED;
-	}
-
-	// All ok
-	return NO_ERROR;
+	// Identifiers are resolved once all symbols are known, and constants are folded
+	// once type checking has added all casts, even the ones below visited nodes
+	PassManager passes (compilation_->getOptions ().pass_fusion);
+	passes.addPass ("find symbols", find_symbols, PASS_AFTER_TREE);
+	passes.addPass ("resolve identifiers", resolve_identifiers, PASS_AFTER_TREE);
+	passes.addPass ("check types", check_types, PASS_AFTER_SUBTREE);
+	passes.addPass ("fold constants", fold_constants, PASS_AFTER_TREE);
+	passes.addPass ("find counted loops", find_counted_loops, PASS_AFTER_SUBTREE);
+
+	return passes.run (root_node_, compilation_);
 }
 
-void ParserContext::printTreeRecursive (std::ostream &stream, int level, ParserNode *node)
+void ParserContext::printTreeNodes (std::ostream &stream, ParserNode *root)
 {
-	if (node == nullptr)
-		return;
+	// Nodes left to print with their level; the list of a node is printed after its
+	// children, so it goes on the stack first
+	std::stack<std::pair<ParserNode *, int>> pending;
+	pending.push (std::make_pair (root, 0));
 
-	// Print address
-	std::cout << "<addr=" << node << ">  ";
+	while (!pending.empty ())
+	{
+		ParserNode *node = pending.top ().first;
+		int level = pending.top ().second;
+		pending.pop ();
 
-	// Pad for level
-	for (int i = 0; i < level; i ++)
-		std::cout << "  ";
+		// Print address
+		stream << "<addr=" << node << ">  ";
 
-	// Print text
-	std::cout << node->toString ();
-	if (node->getNext () != nullptr)
-	{
-		std::cout << "  <next=" << node->getNext () << ">";
-	}
-	std::cout << std::endl;
+		// Pad for level
+		for (int i = 0; i < level; i ++)
+			stream << "  ";
 
-	// Print children
-	std::list<ParserNode *> ch = node->getChildren();
-	for (std::list<ParserNode *>::iterator it = ch.begin(); it != ch.end(); it ++)
-	{
-		printTreeRecursive (stream, level+1, *it);
-	}
+		// Print text
+		stream << node->toString ();
+		if (node->getNext () != nullptr)
+		{
+			stream << "  <next=" << node->getNext () << ">";
+			pending.push (std::make_pair (node->getNext (), level));
+		}
+		stream << std::endl;
 
-	// Print list
-	printTreeRecursive (stream, level, node->getNext ());
+		// Children, in reverse so that the first one is printed first
+		ChildSlots children = node->getChildSlots ();
+		for (unsigned int i = children.count; i > 0; i --)
+		{
+			if (children.get (i - 1) != nullptr)
+			{
+				pending.push (std::make_pair (children.get (i - 1), level+1));
+			}
+		}
+	}
 }
 
 int ParserContext::printTree (std::ostream &stream)
 {
 	if (root_node_ != nullptr)
 	{
-		printTreeRecursive (stream, 0, root_node_);
+		printTreeNodes (stream, root_node_);
 		return NO_ERROR;
 	}
 	else
@@ -156,7 +150,7 @@ int ParserContext::printProgram (std::ostream &stream)
 {
 	if (root_node_ != nullptr)
 	{
-		stream << root_node_->print ("") << std::endl;
+		stream << ParserNode::printList (root_node_, "") << std::endl;
 		return NO_ERROR;
 	}
 	else
@@ -170,12 +164,12 @@ IlProgram *ParserContext::generateIlCode ()
 {
 	if (root_node_ != nullptr)
 	{
-		IlProgram *program = new IlProgram ();
+		IlProgram *program = new IlProgram (compilation_);
 		IlBlock *block = program->getMainBlock ();
 		if (TreeWalker::codeGenerationWalk (getRoot(), block) != NO_ERROR)
 		{
 			Error::internalError ("code generation failed!");
-			delete block;
+			delete program;
 			return nullptr;
 		}
 		else
@@ -6,25 +6,34 @@
 #include "parser.hh"
 #include "lexer.h"
 #include "nodes/parser-node.h"
+#include "tree-walker.h"
 #include "ilang/il-program.h"
 
 using namespace yy;
 
+class Compilation;
+
 class ParserContext
 {
 private:
+	// Compilation this context belongs to
+	Compilation *compilation_;
+
 	Parser *parser_;
 	Lexer *lexer_;
 	ParserNode *root_node_;
 
-	// Print a tree node to a stream and call itself on all children.
-	// "level" determines indentation level and increases with each layer.
-	void printTreeRecursive (std::ostream &stream, int level, ParserNode *node);
+	// Print a tree node, its children and its list to a stream; the indentation level
+	// increases with each layer.
+	void printTreeNodes (std::ostream &stream, ParserNode *root);
 
 public:
-	ParserContext ();
+	ParserContext (Compilation *compilation);
 	~ParserContext ();
 
+	// Get the compilation this context belongs to
+	Compilation *getCompilation () const { return compilation_; }
+
 	// Get the root node
 	ParserNode *getRoot () const { return root_node_; }
 
@@ -0,0 +1,44 @@
+#include "pass-manager.h"
+#include "error/error.h"
+#include "compilation.h"
+
+PassManager::PassManager (bool fuse)
+	: fuse_ (fuse)
+{
+}
+
+void PassManager::addPass (std::string name, WALK_CALLBACK callback, PassDependency dependency)
+{
+	if (fuse_ && dependency == PASS_AFTER_SUBTREE && !walks_.empty ())
+	{
+		walks_.back ().name += " + " + name;
+		walks_.back ().callbacks.push_back (callback);
+	}
+	else
+	{
+		walks_.push_back (Walk ());
+		walks_.back ().name = name;
+		walks_.back ().callbacks.push_back (callback);
+	}
+}
+
+int PassManager::run (ParserNode *&root, Compilation *compilation)
+{
+	TimeReport *report = compilation->getTimeReport ();
+
+	for (std::vector<Walk>::iterator it = walks_.begin (); it != walks_.end (); it ++)
+	{
+		int phase = report->begin (it->name);
+		WalkTuple ret = TreeWalker::leafToRoot (root, it->callbacks, false, compilation);
+		root = std::get<1> (ret);
+		report->end (phase);
+
+		if (std::get<0> (ret) != NO_ERROR)
+		{
+			return std::get<0> (ret);
+		}
+	}
+
+	// All ok
+	return NO_ERROR;
+}
@@ -0,0 +1,58 @@
+#ifndef PASS_MANAGER_H_
+#define PASS_MANAGER_H_
+
+#include <string>
+#include <vector>
+#include "tree-walker.h"
+
+class Compilation;
+
+//
+// What a pass needs from the passes added before it
+//
+enum PassDependency
+{
+	// The earlier passes done on the node and everything below it; the pass runs in the
+	// same walk as the pass before it
+	PASS_AFTER_SUBTREE,
+	// The earlier passes done on the whole tree; the pass starts a new walk
+	PASS_AFTER_TREE
+};
+
+//
+// Pass manager
+// Runs a sequence of leaf to root passes over a tree, fusing the passes that only
+// depend on the subtree of a node into a single walk.
+//
+class PassManager
+{
+private:
+	//
+	// Passes run in a single walk
+	//
+	struct Walk
+	{
+		std::string name;
+		std::vector<WALK_CALLBACK> callbacks;
+	};
+
+	std::vector<Walk> walks_;
+
+	// Fuse passes into walks
+	bool fuse_;
+
+public:
+	PassManager (bool fuse);
+
+	// Add a pass, run after the ones added before it
+	void addPass (std::string name, WALK_CALLBACK callback, PassDependency dependency);
+
+	// Get the number of walks the passes need
+	unsigned int getWalkCount () const { return walks_.size (); }
+
+	// Run all passes, every walk timed in the compilation's report; root is updated if
+	// it gets replaced
+	int run (ParserNode *&root, Compilation *compilation);
+};
+
+#endif
@@ -1,7 +1,21 @@
 #include "tree-walker.h"
 #include "error/error.h"
 
-ParserNode *TreeWalker::leafToRootWalk (ParserNode *node, struct TreeWalkContext *context, WALK_CALLBACK callback)
+void TreeWalker::pushFrame (std::deque<WalkFrame> &frames, ParserNode *node, ParserNode **child_ref, struct TreeWalkContext *context)
+{
+	frames.push_back (WalkFrame ());
+	WalkFrame &frame = frames.back ();
+	frame.node = node;
+	frame.state = WalkFrame::WALK_CHILDREN;
+	frame.child_ref = child_ref;
+	frame.children = node->getChildSlots ();
+	frame.child = 0;
+
+	// Add node to stack
+	context->node_stack.push (node);
+}
+
+ParserNode *TreeWalker::leafToRootWalk (ParserNode *node, struct TreeWalkContext *context, const std::vector<WALK_CALLBACK> &callbacks)
 {
 	if (node == nullptr)
 	{
@@ -9,72 +23,107 @@ ParserNode *TreeWalker::leafToRootWalk (ParserNode *node, struct TreeWalkContext
 		return nullptr;
 	}
 
-	// Add node to stack
-	context->node_stack.push (node);
+	// Same order as a recursive walk: a node's children, then the rest of its list,
+	// then the node itself. A deque keeps the frames in place as it grows.
+	std::deque<WalkFrame> frames;
+	pushFrame (frames, node, nullptr, context);
 
-	// Walk children
-	std::list<ParserNode **> children_refs = node->getChildrenReferences ();
-	for (std::list<ParserNode **>::iterator it = children_refs.begin ();
-		 it != children_refs.end (); it ++)
+	ParserNode *result = nullptr;
+	while (!frames.empty ())
 	{
-		// Get iterator value
-		ParserNode **child = *it;
+		size_t index = frames.size () - 1;
+		ParserNode *current = frames[index].node;
 
-		if (child != nullptr && *child != nullptr)
+		if (frames[index].state == WalkFrame::WALK_CHILDREN)
 		{
-			// Walk child
-			ParserNode *ret = leafToRootWalk (*child, context, callback);
+			// Walk next child
+			ParserNode **child = nullptr;
+			while (context->ret_code == NO_ERROR && frames[index].child < frames[index].children.count)
+			{
+				child = frames[index].children.slots[frames[index].child];
+				frames[index].child ++;
+				if (*child != nullptr)
+				{
+					break;
+				}
+				child = nullptr;
+			}
 
-			// Handle change
-			if (ret != *child)
+			if (child != nullptr)
+			{
+				pushFrame (frames, *child, child, context);
+				continue;
+			}
+
+			// Children done, pop node from stack
+			context->node_stack.pop ();
+			frames[index].state = WalkFrame::WALK_NEXT;
+
+			// Walk list
+			ParserNode *next = current->getNext ();
+			if (next != nullptr && context->ret_code == NO_ERROR)
 			{
-				ret->setNext ((*child)->getNext ());
-				(*child)->setNext (nullptr);
-				delete *child;
-				*child = ret;
+				pushFrame (frames, next, nullptr, context);
 			}
+			continue;
 		}
 
-		if (context->ret_code != NO_ERROR)
+		// Apply to node; a replacement takes over the rest of the list right away, so that
+		// the callbacks after it see the same list as a walk of their own would. A node
+		// replaced again by a later callback is not linked anywhere else, so it is deleted.
+		ParserNode *new_node = current;
+		for (size_t i = 0; i < callbacks.size () && context->ret_code == NO_ERROR; i ++)
 		{
-			break;
+			ParserNode *ret = callbacks[i] (new_node, context);
+			if (ret != new_node)
+			{
+				ret->setNext (current->getNext ());
+				if (new_node != current)
+				{
+					new_node->setNext (nullptr);
+					delete new_node;
+				}
+			}
+			new_node = ret;
 		}
-	}
-
-	// Pop node from stack
-	context->node_stack.pop ();
+		ParserNode **child_ref = frames[index].child_ref;
+		frames.pop_back ();
 
-	// Walk list
-	ParserNode *next = node->getNext ();
-	if (next != nullptr && context->ret_code == NO_ERROR)
-	{
-		ParserNode *new_next = leafToRootWalk (next, context, callback);
-		if (new_next != next)
+		if (frames.empty ())
 		{
-			new_next->setNext (next->getNext ());
-			next->setNext (nullptr);
-			delete next;
-			node->setNext (new_next);
+			result = new_node;
+		}
+		else if (new_node != current)
+		{
+			// Handle change
+			new_node->setNext (current->getNext ());
+			current->setNext (nullptr);
+			delete current;
+			if (child_ref != nullptr)
+			{
+				*child_ref = new_node;
+			}
+			else
+			{
+				frames.back ().node->setNext (new_node);
+			}
 		}
 	}
 
-	if (context->ret_code == NO_ERROR)
-	{
-		// Apply to node
-		ParserNode *new_node = callback (node, context);
-		return new_node;
-	}
-	else
-	{
-		return node;
-	}
+	return result;
+}
+
+WalkTuple TreeWalker::leafToRoot (ParserNode *root, WALK_CALLBACK callback, bool omit_root_list, Compilation *compilation)
+{
+	return leafToRoot (root, std::vector<WALK_CALLBACK> (1, callback), omit_root_list, compilation);
 }
 
-WalkTuple TreeWalker::leafToRoot (ParserNode *root, WALK_CALLBACK callback, bool omit_root_list)
+WalkTuple TreeWalker::leafToRoot (ParserNode *root, const std::vector<WALK_CALLBACK> &callbacks, bool omit_root_list, Compilation *compilation)
 {
 	// Create context
 	struct TreeWalkContext context;
 	context.ret_code = NO_ERROR;
+	context.compilation = compilation;
 
 	// Unlink next if omit_root_list
 	ParserNode *saved_list = root->getNext ();
@@ -84,9 +133,10 @@ WalkTuple TreeWalker::leafToRoot (ParserNode *root, WALK_CALLBACK callback, bool
 	}
 
 	// Call on root
-	ParserNode *new_root = leafToRootWalk (root, &context, callback);
+	ParserNode *new_root = leafToRootWalk (root, &context, callbacks);
 	if (new_root != root)
 	{
+		new_root->setNext (root->getNext ());
 		root->setNext (nullptr);
 		delete root;
 	}
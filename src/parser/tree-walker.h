@@ -1,12 +1,15 @@
 #ifndef TREE_WALKER_H_
 #define TREE_WALKER_H_
 
-#include <list>
 #include <stack>
 #include <tuple>
+#include <deque>
+#include <vector>
 #include "nodes/parser-node.h"
 #include "ilang/il-block.h"
 
+class Compilation;
+
 //
 // Tree walk context
 //
@@ -14,6 +17,8 @@ struct TreeWalkContext
 {
 	std::stack<ParserNode *> node_stack;
 	int ret_code;
+	// Compilation the tree belongs to
+	Compilation *compilation;
 };
 
 //
@@ -34,16 +39,45 @@ typedef std::tuple<int, ParserNode *> WalkTuple;
 class TreeWalker
 {
 private:
-	// Function that will be called recursively for all children nodes
-	static ParserNode *leafToRootWalk (ParserNode *node, struct TreeWalkContext *context, WALK_CALLBACK callback);
+	//
+	// Pending node of a walk; the walk keeps these on the heap instead of recursing,
+	// so that long statement lists and deep expressions don't overflow the stack
+	//
+	struct WalkFrame
+	{
+		enum State
+		{
+			WALK_CHILDREN,
+			WALK_NEXT
+		};
+
+		ParserNode *node;
+		State state;
+		// Where the node is linked: a child reference of the parent frame's node, or
+		// the parent frame's node next pointer if null
+		ParserNode **child_ref;
+		ChildSlots children;
+		unsigned int child;
+	};
+
+	// Start walking a node
+	static void pushFrame (std::deque<WalkFrame> &frames, ParserNode *node, ParserNode **child_ref, struct TreeWalkContext *context);
+
+	// Walks the tree below node (and its list) and returns the node that replaces it
+	static ParserNode *leafToRootWalk (ParserNode *node, struct TreeWalkContext *context, const std::vector<WALK_CALLBACK> &callbacks);
 
 public:
 	// Function for a depth-first walk with the callback called for children first and for parent afterwards.
 	// root (in): node to start with
 	// callback (in): function to call for each node
 	// omit_root_list (in): if true, will not walk root->getNext().
+	// compilation (in): compilation the tree belongs to, passed to the callback in the context
 	// Returns root or new tree pointer (if root was replaced).
-	static WalkTuple leafToRoot (ParserNode *root, WALK_CALLBACK callback, bool omit_root_list);
+	static WalkTuple leafToRoot (ParserNode *root, WALK_CALLBACK callback, bool omit_root_list, Compilation *compilation);
+
+	// Same walk, calling several callbacks in order on each node; a callback is given the
+	// node returned by the one before it.
+	static WalkTuple leafToRoot (ParserNode *root, const std::vector<WALK_CALLBACK> &callbacks, bool omit_root_list, Compilation *compilation);
 
 	// Function for the walk specific for code generation.
 	// This will only walk the root list and handle function definitions and such high level management.
@@ -0,0 +1,80 @@
+#include "allocation-counter.h"
+#include <new>
+#include <cstdlib>
+
+//
+// Counters of the calling thread
+//
+static thread_local unsigned long allocation_count = 0;
+static thread_local unsigned long allocation_bytes = 0;
+
+unsigned long AllocationCounter::getCount ()
+{
+	return allocation_count;
+}
+
+unsigned long AllocationCounter::getBytes ()
+{
+	return allocation_bytes;
+}
+
+//
+// Allocate counting the allocation
+//
+static void *allocate (std::size_t size)
+{
+	allocation_count ++;
+	allocation_bytes += size;
+
+	return malloc (size > 0 ? size : 1);
+}
+
+//
+// Replacements of the global allocation functions
+// All forms are replaced, so that memory is never released by a function other than
+// the one matching its allocation.
+//
+void *operator new (std::size_t size)
+{
+	void *pointer = allocate (size);
+	if (pointer == nullptr)
+	{
+		throw std::bad_alloc ();
+	}
+	return pointer;
+}
+
+void *operator new[] (std::size_t size)
+{
+	return operator new (size);
+}
+
+void *operator new (std::size_t size, const std::nothrow_t &) noexcept
+{
+	return allocate (size);
+}
+
+void *operator new[] (std::size_t size, const std::nothrow_t &) noexcept
+{
+	return allocate (size);
+}
+
+void operator delete (void *pointer) noexcept
+{
+	free (pointer);
+}
+
+void operator delete[] (void *pointer) noexcept
+{
+	free (pointer);
+}
+
+void operator delete (void *pointer, const std::nothrow_t &) noexcept
+{
+	free (pointer);
+}
+
+void operator delete[] (void *pointer, const std::nothrow_t &) noexcept
+{
+	free (pointer);
+}
@@ -0,0 +1,17 @@
+#ifndef ALLOCATION_COUNTER_H_
+#define ALLOCATION_COUNTER_H_
+
+//
+// Heap allocation counter
+// The global operator new is replaced to count allocations and allocated bytes. The
+// counters are per thread, so concurrent compilations only see their own allocations.
+//
+class AllocationCounter
+{
+public:
+	// Get the number of allocations and of allocated bytes of the calling thread
+	static unsigned long getCount ();
+	static unsigned long getBytes ();
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "time-report.h"
+#include <iomanip>
+#include <ctime>
+#include <sys/resource.h>
+#include "error/error.h"
+#include "allocation-counter.h"
+
+//
+// Width of the phase column of the table
+//
+#define NAME_WIDTH					44
+#define VALUE_WIDTH					12
+
+//
+// Format a duration given in microseconds as milliseconds
+//
+static std::string format_ms (unsigned long us)
+{
+	return std::to_string (us / 1000) + "." + std::to_string (1000 + us % 1000).substr (1);
+}
+
+//
+// Quote a string for JSON
+//
+static std::string quote_json (const std::string &text)
+{
+	std::string quoted = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			quoted += '\\';
+			quoted += c;
+		}
+		else if ((unsigned char) c < 0x20)
+		{
+			static const char digits[] = "0123456789abcdef";
+			quoted += "\\u00";
+			quoted += digits[(c >> 4) & 0xf];
+			quoted += digits[c & 0xf];
+		}
+		else
+		{
+			quoted += c;
+		}
+	}
+	return quoted + "\"";
+}
+
+int TimeReport::begin (std::string name)
+{
+	TimeReportEntry entry;
+	entry.name = name;
+	entry.parent = current_;
+	entry.tool = false;
+	entry.open = true;
+	entry.wall_us = entry.cpu_us = entry.allocations = entry.allocated_bytes = entry.peak_rss_kb = 0;
+
+	// Take the counters last, so that the entry itself is not accounted for
+	entries_.push_back (entry);
+	current_ = entries_.size () - 1;
+	entries_[current_].allocations_start = AllocationCounter::getCount ();
+	entries_[current_].allocated_bytes_start = AllocationCounter::getBytes ();
+	entries_[current_].cpu_start = getThreadCpuTime ();
+	entries_[current_].wall_start = std::chrono::steady_clock::now ();
+
+	return current_;
+}
+
+void TimeReport::end (int phase)
+{
+	std::chrono::steady_clock::time_point wall_end = std::chrono::steady_clock::now ();
+	unsigned long cpu_end = getThreadCpuTime ();
+	unsigned long allocations_end = AllocationCounter::getCount ();
+	unsigned long allocated_bytes_end = AllocationCounter::getBytes ();
+	unsigned long peak_rss_kb = getPeakRss ();
+
+	if (phase < 0 || phase >= (int) entries_.size () || !entries_[phase].open)
+	{
+		Error::internalError ("time report phase closed twice");
+		return;
+	}
+
+	// Phases left open by an early return end along with their parent
+	while (current_ >= phase)
+	{
+		TimeReportEntry &entry = entries_[current_];
+		entry.wall_us = std::chrono::duration_cast<std::chrono::microseconds> (wall_end - entry.wall_start).count ();
+		entry.cpu_us = cpu_end - entry.cpu_start;
+		entry.allocations = allocations_end - entry.allocations_start;
+		entry.allocated_bytes = allocated_bytes_end - entry.allocated_bytes_start;
+		entry.peak_rss_kb = peak_rss_kb;
+		entry.open = false;
+		current_ = entry.parent;
+	}
+}
+
+void TimeReport::addTool (std::string name, const ToolUsage &usage)
+{
+	TimeReportEntry entry;
+	entry.name = name;
+	entry.parent = current_;
+	entry.tool = true;
+	entry.open = false;
+	entry.wall_us = usage.wall_us;
+	entry.cpu_us = usage.cpu_us;
+	entry.allocations = entry.allocated_bytes = 0;
+	entry.peak_rss_kb = usage.peak_rss_kb;
+	entries_.push_back (entry);
+}
+
+void TimeReport::printEntry (std::ostream &stream, int index, unsigned int level) const
+{
+	const TimeReportEntry &entry = entries_[index];
+	std::string name = std::string (level * 2, ' ') + entry.name + (entry.tool ? " (tool)" : "");
+
+	stream << std::left << std::setw (NAME_WIDTH) << name << std::right
+		   << std::setw (VALUE_WIDTH) << format_ms (entry.wall_us)
+		   << std::setw (VALUE_WIDTH) << format_ms (entry.cpu_us);
+	if (entry.tool)
+	{
+		stream << std::setw (VALUE_WIDTH) << "-" << std::setw (VALUE_WIDTH) << "-";
+	}
+	else
+	{
+		stream << std::setw (VALUE_WIDTH) << entry.allocations
+			   << std::setw (VALUE_WIDTH) << (entry.allocated_bytes + 1023) / 1024;
+	}
+	stream << std::setw (VALUE_WIDTH) << entry.peak_rss_kb << std::endl;
+
+	for (unsigned int i = index + 1; i < entries_.size (); i ++)
+	{
+		if (entries_[i].parent == index)
+		{
+			printEntry (stream, i, level + 1);
+		}
+	}
+}
+
+void TimeReport::print (std::ostream &stream) const
+{
+	stream << std::endl << "[TIME REPORT]" << std::endl;
+	stream << std::left << std::setw (NAME_WIDTH) << "phase" << std::right
+		   << std::setw (VALUE_WIDTH) << "wall ms"
+		   << std::setw (VALUE_WIDTH) << "cpu ms"
+		   << std::setw (VALUE_WIDTH) << "allocs"
+		   << std::setw (VALUE_WIDTH) << "alloc KB"
+		   << std::setw (VALUE_WIDTH) << "peak RSS KB" << std::endl;
+
+	unsigned long tool_wall_us = 0, tool_cpu_us = 0;
+	for (unsigned int i = 0; i < entries_.size (); i ++)
+	{
+		if (entries_[i].parent < 0)
+		{
+			printEntry (stream, i, 0);
+		}
+		if (entries_[i].tool)
+		{
+			tool_wall_us += entries_[i].wall_us;
+			tool_cpu_us += entries_[i].cpu_us;
+		}
+	}
+
+	stream << "child tools: " << format_ms (tool_wall_us) << " ms wall, " << format_ms (tool_cpu_us) << " ms cpu" << std::endl;
+	stream << "[TIME REPORT END]" << std::endl << std::endl;
+}
+
+void TimeReport::printEntryJson (std::ostream &stream, int index, unsigned int level) const
+{
+	const TimeReportEntry &entry = entries_[index];
+	std::string indent (level * 2, ' ');
+
+	stream << indent << "{ \"name\": " << quote_json (entry.name);
+	if (entry.tool)
+	{
+		stream << ", \"tool\": true";
+	}
+	stream << ", \"wall_ms\": " << format_ms (entry.wall_us) << ", \"cpu_ms\": " << format_ms (entry.cpu_us);
+	if (!entry.tool)
+	{
+		stream << ", \"allocations\": " << entry.allocations << ", \"allocated_bytes\": " << entry.allocated_bytes;
+	}
+	stream << ", \"peak_rss_kb\": " << entry.peak_rss_kb;
+
+	bool first = true;
+	for (unsigned int i = index + 1; i < entries_.size (); i ++)
+	{
+		if (entries_[i].parent == index)
+		{
+			stream << (first ? ", \"phases\": [\n" : ",\n");
+			printEntryJson (stream, i, level + 1);
+			first = false;
+		}
+	}
+	if (!first)
+	{
+		stream << "\n" << indent << "]";
+	}
+	stream << " }";
+}
+
+void TimeReport::printJson (std::ostream &stream, std::string input_file, int ret_code) const
+{
+	unsigned long tool_wall_us = 0, tool_cpu_us = 0;
+	for (const TimeReportEntry &entry : entries_)
+	{
+		if (entry.tool)
+		{
+			tool_wall_us += entry.wall_us;
+			tool_cpu_us += entry.cpu_us;
+		}
+	}
+
+	stream << "{" << std::endl;
+	stream << "  \"input\": " << quote_json (input_file) << "," << std::endl;
+	stream << "  \"status\": " << (ret_code == NO_ERROR ? "\"ok\"" : "\"failed\"") << "," << std::endl;
+	stream << "  \"tools\": { \"wall_ms\": " << format_ms (tool_wall_us) << ", \"cpu_ms\": " << format_ms (tool_cpu_us) << " }," << std::endl;
+	stream << "  \"phases\": [" << std::endl;
+	bool first = true;
+	for (unsigned int i = 0; i < entries_.size (); i ++)
+	{
+		if (entries_[i].parent < 0)
+		{
+			stream << (first ? "" : ",\n");
+			printEntryJson (stream, i, 2);
+			first = false;
+		}
+	}
+	stream << std::endl << "  ]" << std::endl;
+	stream << "}" << std::endl;
+}
+
+unsigned long TimeReport::getThreadCpuTime ()
+{
+	struct timespec time;
+	if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+	{
+		return 0;
+	}
+	return time.tv_sec * 1000000UL + time.tv_nsec / 1000;
+}
+
+unsigned long TimeReport::getPeakRss ()
+{
+	struct rusage usage;
+	if (getrusage (RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+	return usage.ru_maxrss;
+}
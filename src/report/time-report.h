@@ -0,0 +1,84 @@
+#ifndef TIME_REPORT_H_
+#define TIME_REPORT_H_
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+#include "backends/interface/tool-runner.h"
+
+//
+// Time report formats
+//
+#define TIME_REPORT_NONE			0
+#define TIME_REPORT_TEXT			1
+#define TIME_REPORT_JSON			2
+
+//
+// Time and memory report of a compilation
+// Phases are opened and closed around the compiler stages and may nest, e.g. the passes
+// of semantic analysis. Each phase records wall and CPU time, the heap allocations made
+// and the peak resident set size of the process when it ended. Tools run by the backend
+// are recorded with their own wall and CPU time and peak resident set size.
+// Measurements are taken on the calling thread, so concurrent compilations each report
+// their own time and allocations; the resident set size is shared by the whole process.
+//
+class TimeReport
+{
+private:
+	struct TimeReportEntry
+	{
+		std::string name;
+		// Index of the enclosing phase, -1 for top level phases
+		int parent;
+		bool tool;
+		bool open;
+
+		unsigned long wall_us;
+		unsigned long cpu_us;
+		unsigned long allocations;
+		unsigned long allocated_bytes;
+		unsigned long peak_rss_kb;
+
+		// Counters when the phase began
+		std::chrono::steady_clock::time_point wall_start;
+		unsigned long cpu_start;
+		unsigned long allocations_start;
+		unsigned long allocated_bytes_start;
+	};
+
+	std::vector<TimeReportEntry> entries_;
+
+	// Innermost open phase, -1 if none
+	int current_;
+
+	// Print an entry and the ones nested in it
+	void printEntry (std::ostream &stream, int index, unsigned int level) const;
+	void printEntryJson (std::ostream &stream, int index, unsigned int level) const;
+
+public:
+	TimeReport () : current_ (-1) { }
+
+	// Open a phase nested in the current one; returns its index
+	int begin (std::string name);
+
+	// Close a phase, along with phases still open inside it
+	void end (int phase);
+
+	// Record a tool run in the current phase
+	void addTool (std::string name, const ToolUsage &usage);
+
+	// Print the report as a table
+	void print (std::ostream &stream) const;
+
+	// Print the report as a JSON document
+	void printJson (std::ostream &stream, std::string input_file, int ret_code) const;
+
+	// Get the CPU time of the calling thread, in microseconds
+	static unsigned long getThreadCpuTime ();
+
+	// Get the peak resident set size of the process, in kilobytes
+	static unsigned long getPeakRss ();
+};
+
+#endif
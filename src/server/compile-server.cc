@@ -0,0 +1,251 @@
+#include "compile-server.h"
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <mutex>
+#include <cerrno>
+#include <csignal>
+#include <climits>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "error/error.h"
+#include "server-protocol.h"
+
+//
+// Pending connections queued by the kernel
+//
+#define SERVER_BACKLOG				64
+
+//
+// Seconds a client gets for each read and write of a request, so that clients that
+// connect and send nothing can't hold the pool threads
+//
+#define SERVER_IO_TIMEOUT			10
+
+//
+// Signals are turned into a byte on this pipe, watched by the accepting thread
+//
+static int stop_pipe[2] = { -1, -1 };
+
+static void stop_handler (int)
+{
+	char c = 0;
+	if (write (stop_pipe[1], &c, 1) < 0)
+	{
+		// Nothing to do from a signal handler
+	}
+}
+
+//
+// Serializes the request log lines of the pool threads
+//
+static std::mutex log_mutex;
+
+CompileServer::CompileServer (std::string socket_path, unsigned int threads)
+	: socket_path_ (socket_path), listen_fd_ (-1), pool_ (threads > 0 ? threads : ThreadPool::getCoreCount ())
+{
+}
+
+CompileServer::~CompileServer ()
+{
+	if (listen_fd_ >= 0)
+	{
+		close (listen_fd_);
+		unlink (socket_path_.c_str ());
+	}
+}
+
+int CompileServer::listen ()
+{
+	struct sockaddr_un address;
+	if (ServerProtocol::getAddress (socket_path_, address) != NO_ERROR)
+	{
+		return ER_FAILED;
+	}
+
+	// A socket nobody answers on is left over by a dead server
+	int fd = ServerProtocol::connect (socket_path_);
+	if (fd >= 0)
+	{
+		close (fd);
+		Error::error ("a server is already listening on '" + socket_path_ + "'");
+		return ER_FAILED;
+	}
+	unlink (socket_path_.c_str ());
+
+	// Only the owner may connect; the mode is set before listening, so no client can
+	// connect in between
+	listen_fd_ = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listen_fd_ < 0
+		|| bind (listen_fd_, (struct sockaddr *) &address, sizeof (address)) != 0
+		|| chmod (socket_path_.c_str (), 0600) != 0
+		|| ::listen (listen_fd_, SERVER_BACKLOG) != 0)
+	{
+		Error::error ("cannot listen on '" + socket_path_ + "'");
+		if (listen_fd_ >= 0)
+		{
+			close (listen_fd_);
+			listen_fd_ = -1;
+		}
+		return ER_FAILED;
+	}
+
+	return NO_ERROR;
+}
+
+void CompileServer::handleConnection (int fd)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+
+	std::string request;
+	CompilationOptions options;
+	std::ostringstream output, diagnostics;
+	int rc = ER_FAILED;
+
+	struct timeval timeout = { SERVER_IO_TIMEOUT, 0 };
+	setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+	setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+	if (ServerProtocol::receiveMessage (fd, request) != NO_ERROR)
+	{
+		// Closed or timed out without a request, e.g. a probe of a starting server
+		close (fd);
+		return;
+	}
+
+	if (ServerProtocol::decodeOptions (request, options) != NO_ERROR)
+	{
+		diagnostics << "Error: malformed compile server request" << std::endl;
+	}
+	else
+	{
+		Compilation compilation (options);
+		compilation.setOutput (output);
+		compilation.setDiagnostics (diagnostics);
+		rc = compilation.run ();
+	}
+
+	// The client may have gone away, nothing to do about it then
+	ServerProtocol::sendMessage (fd, std::to_string (rc));
+	ServerProtocol::sendMessage (fd, output.str ());
+	ServerProtocol::sendMessage (fd, diagnostics.str ());
+	close (fd);
+
+	unsigned int elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now () - start).count ();
+	std::lock_guard<std::mutex> lock (log_mutex);
+	std::cout << "[server] " << (options.input_file.empty () ? "?" : options.input_file)
+			  << (rc == NO_ERROR ? " compiled" : " failed") << " in " << elapsed_ms << " ms" << std::endl;
+}
+
+int CompileServer::run ()
+{
+	if (pipe2 (stop_pipe, O_CLOEXEC) != 0)
+	{
+		Error::internalError ("cannot create signal pipe");
+		return ER_FAILED;
+	}
+
+	struct sigaction action;
+	action.sa_handler = stop_handler;
+	sigemptyset (&action.sa_mask);
+	action.sa_flags = 0;
+	sigaction (SIGINT, &action, nullptr);
+	sigaction (SIGTERM, &action, nullptr);
+
+	pool_.start ();
+	std::cout << "[server] listening on " << socket_path_ << " with " << pool_.getWorkerCount () << " threads" << std::endl;
+
+	while (true)
+	{
+		struct pollfd fds[2] = { { listen_fd_, POLLIN, 0 }, { stop_pipe[0], POLLIN, 0 } };
+		if (poll (fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			Error::internalError ("poll failed on server socket");
+			break;
+		}
+
+		if (fds[1].revents != 0)
+		{
+			// Stop requested
+			break;
+		}
+
+		int fd = accept4 (listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			continue;
+		}
+		pool_.submit ([this, fd] () { handleConnection (fd); });
+	}
+
+	// Finish the requests already accepted
+	std::cout << "[server] stopping" << std::endl;
+	pool_.wait ();
+
+	close (stop_pipe[0]);
+	close (stop_pipe[1]);
+
+	return NO_ERROR;
+}
+
+int CompileServer::compile (std::string socket_path, CompilationOptions options)
+{
+	// The server has its own working directory
+	char cwd[PATH_MAX];
+	if (getcwd (cwd, sizeof (cwd)) == nullptr)
+	{
+		Error::internalError ("cannot get the working directory");
+		return ER_FAILED;
+	}
+	if (options.input_file[0] != '/')
+	{
+		options.input_file = std::string (cwd) + "/" + options.input_file;
+	}
+	if (options.output_file[0] != '/')
+	{
+		options.output_file = std::string (cwd) + "/" + options.output_file;
+	}
+	if (!options.cache_directory.empty () && options.cache_directory[0] != '/')
+	{
+		options.cache_directory = std::string (cwd) + "/" + options.cache_directory;
+	}
+	if (options.input_file.find ('\n') != std::string::npos || options.output_file.find ('\n') != std::string::npos
+		|| options.cache_directory.find ('\n') != std::string::npos)
+	{
+		Error::error ("file names with newlines can't be sent to the compile server");
+		return ER_FAILED;
+	}
+
+	int fd = ServerProtocol::connect (socket_path);
+	if (fd < 0)
+	{
+		Error::error ("cannot connect to compile server on '" + socket_path + "'");
+		return ER_FAILED;
+	}
+
+	std::string rc, output, diagnostics;
+	if (ServerProtocol::sendMessage (fd, ServerProtocol::encodeOptions (options)) != NO_ERROR
+		|| ServerProtocol::receiveMessage (fd, rc) != NO_ERROR
+		|| ServerProtocol::receiveMessage (fd, output) != NO_ERROR
+		|| ServerProtocol::receiveMessage (fd, diagnostics) != NO_ERROR)
+	{
+		close (fd);
+		Error::error ("compile server on '" + socket_path + "' did not answer");
+		return ER_FAILED;
+	}
+	close (fd);
+
+	std::cout << output << std::flush;
+	std::cerr << diagnostics << std::flush;
+
+	return atoi (rc.c_str ());
+}
@@ -0,0 +1,38 @@
+#ifndef COMPILE_SERVER_H_
+#define COMPILE_SERVER_H_
+
+#include <string>
+#include "compilation.h"
+#include "batch/thread-pool.h"
+
+//
+// Compile server
+// Listens on a Unix domain socket and runs every request as a Compilation on a thread
+// pool, so requests skip process startup and are compiled concurrently.
+//
+class CompileServer
+{
+private:
+	std::string socket_path_;
+	int listen_fd_;
+
+	ThreadPool pool_;
+
+	// Serve a single connection, called on a pool thread
+	void handleConnection (int fd);
+
+public:
+	CompileServer (std::string socket_path, unsigned int threads);
+	~CompileServer ();
+
+	// Create the socket; a stale socket left by a dead server is replaced
+	int listen ();
+
+	// Serve requests until SIGINT or SIGTERM
+	int run ();
+
+	// Compile through a server, as a client
+	static int compile (std::string socket_path, CompilationOptions options);
+};
+
+#endif
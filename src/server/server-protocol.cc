@@ -0,0 +1,182 @@
+#include "server-protocol.h"
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <sstream>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "error/error.h"
+
+//
+// Write or read a whole buffer
+//
+static int send_all (int fd, const char *data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t length = send (fd, data, size, MSG_NOSIGNAL);
+		if (length < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (length <= 0)
+		{
+			return ER_FAILED;
+		}
+		data += length;
+		size -= length;
+	}
+	return NO_ERROR;
+}
+
+static int receive_all (int fd, char *data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t length = recv (fd, data, size, 0);
+		if (length < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (length <= 0)
+		{
+			return ER_FAILED;
+		}
+		data += length;
+		size -= length;
+	}
+	return NO_ERROR;
+}
+
+int ServerProtocol::sendMessage (int fd, const std::string &message)
+{
+	uint32_t size = message.size ();
+	if (send_all (fd, (const char *) &size, sizeof (size)) != NO_ERROR)
+	{
+		return ER_FAILED;
+	}
+	return send_all (fd, message.data (), message.size ());
+}
+
+int ServerProtocol::receiveMessage (int fd, std::string &message)
+{
+	uint32_t size;
+	if (receive_all (fd, (char *) &size, sizeof (size)) != NO_ERROR || size > SERVER_MESSAGE_MAX)
+	{
+		return ER_FAILED;
+	}
+
+	message.resize (size);
+	return receive_all (fd, &message[0], size);
+}
+
+std::string ServerProtocol::encodeOptions (const CompilationOptions &options)
+{
+	std::ostringstream stream;
+	stream << "input=" << options.input_file << '\n';
+	stream << "output=" << options.output_file << '\n';
+	stream << "backend=" << options.backend_target << '\n';
+	stream << "verbose=" << options.verbose_flags << '\n';
+	stream << "unroll=" << options.unroll_factor << '\n';
+	stream << "memfd=" << options.assembly_in_memory << '\n';
+	stream << "listing=" << options.listing << '\n';
+	stream << "static=" << options.static_linking << '\n';
+	stream << "cache=" << options.cache_directory << '\n';
+	stream << "cache-size=" << options.cache_size << '\n';
+	stream << "time-report=" << options.time_report << '\n';
+	stream << "pass-fusion=" << options.pass_fusion << '\n';
+	stream << "check-only=" << options.check_only << '\n';
+	return stream.str ();
+}
+
+int ServerProtocol::decodeOptions (const std::string &message, CompilationOptions &options)
+{
+	std::istringstream stream (message);
+	std::string line;
+	while (std::getline (stream, line))
+	{
+		size_t equal = line.find ('=');
+		if (equal == std::string::npos)
+		{
+			return ER_FAILED;
+		}
+		std::string name = line.substr (0, equal);
+		std::string value = line.substr (equal + 1);
+
+		if (name == "input")
+			options.input_file = value;
+		else if (name == "output")
+			options.output_file = value;
+		else if (name == "backend")
+			options.backend_target = value;
+		else if (name == "verbose")
+			options.verbose_flags = strtoul (value.c_str (), nullptr, 10);
+		else if (name == "unroll")
+			options.unroll_factor = strtoul (value.c_str (), nullptr, 10);
+		else if (name == "memfd")
+			options.assembly_in_memory = (value == "1");
+		else if (name == "listing")
+			options.listing = (value == "1");
+		else if (name == "static")
+			options.static_linking = (value == "1");
+		else if (name == "cache")
+			options.cache_directory = value;
+		else if (name == "cache-size")
+			options.cache_size = strtoul (value.c_str (), nullptr, 10);
+		else if (name == "time-report")
+			options.time_report = strtoul (value.c_str (), nullptr, 10);
+		else if (name == "pass-fusion")
+			options.pass_fusion = (value == "1");
+		else if (name == "check-only")
+			options.check_only = (value == "1");
+		else
+			return ER_FAILED;
+	}
+
+	// Paths are resolved by the client, the server's working directory is unrelated
+	if (options.input_file.empty () || options.input_file[0] != '/'
+		|| options.output_file.empty () || options.output_file[0] != '/')
+	{
+		return ER_FAILED;
+	}
+
+	return NO_ERROR;
+}
+
+int ServerProtocol::getAddress (std::string socket_path, struct sockaddr_un &address)
+{
+	memset (&address, 0, sizeof (address));
+	address.sun_family = AF_UNIX;
+	if (socket_path.size () >= sizeof (address.sun_path))
+	{
+		Error::error ("socket path '" + socket_path + "' is too long");
+		return ER_FAILED;
+	}
+	strcpy (address.sun_path, socket_path.c_str ());
+
+	return NO_ERROR;
+}
+
+int ServerProtocol::connect (std::string socket_path)
+{
+	struct sockaddr_un address;
+	if (getAddress (socket_path, address) != NO_ERROR)
+	{
+		return ER_FAILED;
+	}
+
+	int fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		return ER_FAILED;
+	}
+
+	if (::connect (fd, (struct sockaddr *) &address, sizeof (address)) != 0)
+	{
+		close (fd);
+		return ER_FAILED;
+	}
+
+	return fd;
+}
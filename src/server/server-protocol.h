@@ -0,0 +1,38 @@
+#ifndef SERVER_PROTOCOL_H_
+#define SERVER_PROTOCOL_H_
+
+#include <string>
+#include <sys/un.h>
+#include "compilation.h"
+
+//
+// Largest message accepted from the other end
+//
+#define SERVER_MESSAGE_MAX			(64 << 20)
+
+//
+// Compile server protocol
+// A client connects to the server's Unix domain socket and sends one request message
+// holding the compilation options, with absolute paths. The server answers with three
+// messages: the return code, the compilation output and the diagnostics. Messages are
+// a 32bit length followed by the data.
+//
+class ServerProtocol
+{
+public:
+	// Send and receive a message
+	static int sendMessage (int fd, const std::string &message);
+	static int receiveMessage (int fd, std::string &message);
+
+	// Encode and decode compilation options, one "name=value" line per option
+	static std::string encodeOptions (const CompilationOptions &options);
+	static int decodeOptions (const std::string &message, CompilationOptions &options);
+
+	// Fill a socket address; fails if the path is too long
+	static int getAddress (std::string socket_path, struct sockaddr_un &address);
+
+	// Connect to a server socket; returns the descriptor or ER_FAILED
+	static int connect (std::string socket_path);
+};
+
+#endif
@@ -1,12 +1,19 @@
 #include "symbol-table.h"
-#include <iostream>
 #include <iomanip>
 #include "error/error.h"
 
-std::unordered_map<std::string, Symbol *> SymbolTable::table_;
+SymbolTable::~SymbolTable ()
+{
+	clear ();
+}
 
 void SymbolTable::clear ()
 {
+	for (std::unordered_map<std::string, Symbol *>::iterator it = table_.begin ();
+		 it != table_.end (); it ++)
+	{
+		delete it->second;
+	}
 	table_.clear ();
 }
 
@@ -29,10 +36,10 @@ Symbol *SymbolTable::getSymbol (std::string name)
 	}
 }
 
-void SymbolTable::debugPrint ()
+void SymbolTable::debugPrint (std::ostream &stream)
 {
-	std::cout << " Symbol Type           Symbol Name" << std::endl;
-	std::cout << "=======================================================" << std::endl;
+	stream << " Symbol Type           Symbol Name" << std::endl;
+	stream << "=======================================================" << std::endl;
 
 	for (std::unordered_map<std::string, Symbol *>::iterator it = table_.begin ();
 		 it != table_.end (); it ++)
@@ -44,9 +51,9 @@ void SymbolTable::debugPrint ()
 		{
 		case SY_VARIABLE:
 			vs = (VariableSymbol *) sym;
-			std::cout << std::setw (22) << std::left << std::setfill('.');
-			std::cout << " VARIABLE (" + BasicTypeAlias [vs->getType ()] + ") ";
-			std::cout << std::setw (0) << " " + sym->getName() << std::endl;
+			stream << std::setw (22) << std::left << std::setfill('.');
+			stream << " VARIABLE (" + BasicTypeAlias [vs->getType ()] + ") ";
+			stream << std::setw (0) << " " + sym->getName() << std::endl;
 			break;
 
 		default:
@@ -2,6 +2,7 @@
 #define SYMBOL_TABLE_H_
 
 #include <string>
+#include <ostream>
 #include <unordered_map>
 #include <tuple>
 #include "symbols/basic-types.h"
@@ -64,28 +65,32 @@ public:
 };
 
 //
-// Symbol table static class
+// Symbol table
+// Owned by a compilation; the table owns its symbols
 //
 class SymbolTable
 {
 private:
 	// The actual hash
-	static std::unordered_map<std::string, Symbol *> table_;
+	std::unordered_map<std::string, Symbol *> table_;
 
 public:
+	SymbolTable () { }
+	~SymbolTable ();
+
 	// Clear symbols table
-	static void clear ();
+	void clear ();
 
 	// Add and get a symbol from the table
-	static bool addSymbol (Symbol *sym);
-	static Symbol *getSymbol (std::string name);
+	bool addSymbol (Symbol *sym);
+	Symbol *getSymbol (std::string name);
 
 	// Get iteration essentials for table
-	static std::tuple< std::unordered_map<std::string, Symbol *>::iterator,
-					   std::unordered_map<std::string, Symbol *>::iterator > getIterator ();
+	std::tuple< std::unordered_map<std::string, Symbol *>::iterator,
+				std::unordered_map<std::string, Symbol *>::iterator > getIterator ();
 
 	// Print symbol tree
-	static void debugPrint ();
+	void debugPrint (std::ostream &stream);
 };
 
 #endif
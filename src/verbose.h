@@ -1,29 +1,17 @@
 #ifndef VERBOSE_H_
 #define VERBOSE_H_
 
-//
-// Verbose flags
-//
-extern unsigned int verbose_flags;
-
 //
 // Verbose flags definiton
+// The flags are a compilation option, tested with Compilation::isVerbose
 //
 #define VERBOSE_FLAG_PRINT_PARSED				0x1
 #define VERBOSE_FLAG_PRINT_AST					0x2
 #define VERBOSE_FLAG_PRINT_SYMBOLS				0x4
 #define VERBOSE_FLAG_PRINT_FINAL				0x8
 #define VERBOSE_FLAG_PRINT_GENERATED_IL			0x10
+#define VERBOSE_FLAG_PRINT_CONSTANT_POOL		0x20
 
-#define VERBOSE_FLAG_MAX						0x1F
-
-//
-// Verbose macros
-//
-#define VERBOSE_PRINT_PARSED					(verbose_flags & VERBOSE_FLAG_PRINT_PARSED)
-#define VERBOSE_PRINT_AST						(verbose_flags & VERBOSE_FLAG_PRINT_AST)
-#define VERBOSE_PRINT_SYMBOLS					(verbose_flags & VERBOSE_FLAG_PRINT_SYMBOLS)
-#define VERBOSE_PRINT_FINAL						(verbose_flags & VERBOSE_FLAG_PRINT_FINAL)
-#define VERBOSE_PRINT_GENERATED_IL				(verbose_flags & VERBOSE_FLAG_PRINT_GENERATED_IL)
+#define VERBOSE_FLAG_MAX						0x3F
 
 #endif